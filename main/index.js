@@ -11,6 +11,34 @@
 /** @type {number[]} */
 const ATTEN_TO_MAX_V = [0.95, 1.25, 1.75, 3.3];
 
+// On-device filter chain presets (see scope_filter.h for the types)
+/** @type {Object<string, Array<{type: string, hz?: number, q?: number, taps?: number}>>} */
+const FILTER_PRESETS = {
+  none: [],
+  notch50: [{ type: 'notch', hz: 50, q: 10 }],
+  notch60: [{ type: 'notch', hz: 60, q: 10 }],
+  lp1k: [{ type: 'lowpass', hz: 1000 }],
+  avg8: [{ type: 'avg', taps: 8 }]
+};
+
+// First word of a decoder event frame (see scope_decode.h). Can't be a 12-bit sample.
+/** @type {number} */
+const DECODE_MAGIC = 0xDEC0;
+
+// The decoder needs this many samples per bit (SCOPE_DECODE_MIN_SAMPLES_PER_BIT)
+/** @type {number} */
+const DECODE_MIN_SAMPLES_PER_BIT = 3;
+
+// How many decoded characters to keep on screen
+/** @type {number} */
+const DECODE_LOG_LEN = 64;
+
+// Mask test window in samples (see scope_mask.h), and how much of it is before the trigger
+/** @type {number} */
+const MASK_LEN = 1000;
+/** @type {number} */
+const MASK_PRE = 100;
+
 // Data buffer size
 /** @type {number} */
 const countPoints = 4000;
@@ -22,6 +50,8 @@ const countPoints = 4000;
  * @property {number} atten - Attenuation setting index
  * @property {number} bit_width - Bit width (e.g. 12)
  * @property {number} test_hz - Test signal frequency for simulation
+ * @property {string} filter - Key into FILTER_PRESETS
+ * @property {number} decode - UART baud rate to decode, 0 = off
  * @property {number} trigger - Trigger level (-1-4097)
  * @property {boolean} invert - Whether trigger logic is inverted
  */
@@ -33,6 +63,8 @@ let activeConfig = {
   atten: 3, // 11dB Default
   bit_width: 12,
   test_hz: 100,
+  filter: 'none',
+  decode: 0,
   trigger: 2048,
   invert: false
 };
@@ -77,6 +109,11 @@ let lowRateState = {
 /** @type {HTMLSelectElement} */ const bitWidthSelect = /** @type {HTMLSelectElement} */ (document.getElementById('bitWidth'));
 /** @type {HTMLSelectElement} */ const attenSelect = /** @type {HTMLSelectElement} */ (document.getElementById('atten'));
 /** @type {HTMLSelectElement} */ const testHzSelect = /** @type {HTMLSelectElement} */ (document.getElementById('testHz'));
+/** @type {HTMLSelectElement} */ const filterSelect = /** @type {HTMLSelectElement} */ (document.getElementById('filter'));
+/** @type {HTMLSelectElement} */ const decodeSelect = /** @type {HTMLSelectElement} */ (document.getElementById('decode'));
+/** @type {HTMLElement} */ const decodeLogEl = document.getElementById('decodeLog');
+/** @type {HTMLSelectElement} */ const maskSelect = /** @type {HTMLSelectElement} */ (document.getElementById('mask'));
+/** @type {HTMLElement} */ const maskStatusEl = document.getElementById('maskStatus');
 /** @type {HTMLButtonElement} */ const resetBtn = /** @type {HTMLButtonElement} */ (document.getElementById('resetBtn'));
 /** @type {HTMLButtonElement} */ const powerOffBtn = /** @type {HTMLButtonElement} */ (document.getElementById('powerOff'));
 
@@ -104,6 +141,9 @@ let lastMousePosition = { x: null, y: null };
 /** @type {boolean} */
 let isFrozen = false;
 
+/** @type {string} */
+let decodeLog = '';
+
 /** @type {{t: number, v: number}|null} */
 let referencePosition = null; // Store the reference position for deltas
 
@@ -321,6 +361,32 @@ function processData(newData) {
   }
 }
 
+/**
+ * Process a decoder event frame: u16 magic, u16 count, u32 sample_rate,
+ * then count x {u32 sample_index, u16 data, u8 flags, u8 proto}
+ * @param {ArrayBuffer} buf - Raw frame
+ */
+function processDecodeEvents(buf) {
+  const view = new DataView(buf);
+  const count = view.getUint16(2, true);
+
+  for (let i = 0; i < count; i++) {
+    const off = 8 + i * 8;
+    const data = view.getUint16(off + 4, true);
+    const flags = view.getUint8(off + 6);
+
+    if (flags & 0x07) {
+      decodeLog += '\uFFFD'; // framing/parity error or break
+    } else if (data >= 0x20 && data < 0x7f) {
+      decodeLog += String.fromCharCode(data);
+    } else {
+      decodeLog += `\\x${data.toString(16).padStart(2, '0')}`;
+    }
+  }
+  if (decodeLog.length > DECODE_LOG_LEN) decodeLog = decodeLog.slice(-DECODE_LOG_LEN);
+  decodeLogEl.textContent = decodeLog;
+}
+
 /**
  * Push new items to the rolling data buffer
  * @param {Array<number|DownsampledPoint>} newItems - New items to add
@@ -743,7 +809,9 @@ function connect() {
   ws.onmessage = (event) => {
     try {
       const arr = new Uint16Array(event.data);
-      if (arr?.length) {
+      if (arr?.length && arr[0] === DECODE_MAGIC) {
+        processDecodeEvents(event.data);
+      } else if (arr?.length) {
         processData(arr);
       }
     } catch (e) {
@@ -761,18 +829,112 @@ function scheduleReconnect() {
   reconnectTimeout = window.setTimeout(connect, 2000); // Use window.setTimeout explicit
 }
 
+/**
+ * Grey out baud rates the device can't decode at this sample rate, and turn
+ * decoding off if the selected one no longer fits.
+ * @param {number} rate - Sample rate as the device will run it
+ */
+function updateDecodeOptions(rate) {
+  for (const opt of Array.from(decodeSelect.options)) {
+    const baud = parseInt(opt.value) || 0;
+    opt.disabled = baud > 0 && rate / baud < DECODE_MIN_SAMPLES_PER_BIT;
+  }
+  if (decodeSelect.selectedOptions[0]?.disabled) {
+    decodeSelect.value = '0';
+    decodeLogEl.textContent = `Decoder off: too fast for ${rate} Hz`;
+  }
+}
+
+/**
+ * UART decoder settings for /params. Thresholds sit either side of the trigger
+ * level, so you line the trigger up with the middle of the signal.
+ * @returns {Object} decode config
+ */
+function decodeConfig() {
+  const baud = parseInt(decodeSelect.value) || 0;
+  if (!baud) return { proto: 'off' };
+
+  const mid = 4096 - (parseInt(triggerLevel.value) || 2048);
+  return {
+    proto: 'uart',
+    baud,
+    bits: 8,
+    parity: 'none',
+    stop: 1,
+    lo: Math.max(0, mid - 150),
+    hi: Math.min(4095, mid + 150),
+    raw: true
+  };
+}
+
+/** @type {number|undefined} */
+let maskPollTimer;
+
+/**
+ * Poll the mask counters. Cheap: the waveforms only come with ?captures=1.
+ */
+function pollMask() {
+  fetch('/mask').then(res => res.json()).then(m => {
+    if (m.mode === 'off') {
+      maskStatusEl.textContent = '';
+      window.clearInterval(maskPollTimer);
+      maskPollTimer = undefined;
+      maskSelect.value = '0';
+      return;
+    }
+    if (!maskPollTimer) maskPollTimer = window.setInterval(pollMask, 1000);
+    if (maskSelect.value === '0') maskSelect.value = 'on';
+
+    if (m.mode === 'teach') {
+      maskStatusEl.textContent = 'Mask: waiting for trigger...';
+    } else {
+      const link = m.failed ? ` <a href="/mask?captures=1" download="mask_failures.json">${m.captures.length} saved</a>` : '';
+      maskStatusEl.innerHTML = `Mask: ${m.tested} tested, ${m.passed} pass, ${m.failed} fail${link}`;
+    }
+  }).catch(() => { });
+}
+
+/**
+ * Teach a mask from the next waveform on the trigger (same level and edge the
+ * page triggers on), or turn it off.
+ */
+function setMask() {
+  const tol = parseInt(maskSelect.value) || 0;
+  const body = tol ? {
+    mode: 'teach',
+    trigger: triggerLevel.invert ? 'rising' : 'falling',
+    level: 4096 - (parseInt(triggerLevel.value) || 2048),
+    hyst: 50,
+    len: MASK_LEN,
+    pre: MASK_PRE,
+    tol
+  } : { mode: 'off' };
+
+  fetch('/mask', {
+    method: 'POST',
+    headers: { 'Content-Type': 'application/json' },
+    body: JSON.stringify(body)
+  }).then(res => {
+    if (!res.ok) alert('Error setting mask');
+    pollMask();
+  }).catch(err => alert('Network error: ' + err));
+}
+
 /**
  * Send configuration to ESP32
  */
-function setParams() {
+function setParams(retries = 5) {
   const desiredRate = parseInt(sampleRateSelect.value);
-  const hardwareRate = desiredRate < 1000 ? 1000 : desiredRate;
+  const hardwareRate = Math.min(desiredRate < 1000 ? 1000 : desiredRate, 83333); // the number input doesn't enforce max on typed values
+  updateDecodeOptions(Math.max(hardwareRate, 20000)); // the device never runs below 20kHz
 
   const payload = {
     sample_rate: hardwareRate,
     bit_width: parseInt(bitWidthSelect.value),
     atten: parseInt(attenSelect.value),
-    test_hz: parseInt(testHzSelect.value)
+    test_hz: parseInt(testHzSelect.value),
+    filters: FILTER_PRESETS[filterSelect.value] || [],
+    decode: decodeConfig()
   };
 
   fetch('/params', {
@@ -780,23 +942,53 @@ function setParams() {
     headers: { 'Content-Type': 'application/json' },
     body: JSON.stringify(payload)
   }).then(res => {
-    if (res.ok) {
+    if (res.status === 503 && retries > 0) {
+      // Device is still applying the previous change
+      window.setTimeout(() => setParams(retries - 1), 50);
+    } else if (res.ok) {
       lowRateState.accMin = 4096;
       lowRateState.accMax = 0;
       lowRateState.accSum = 0;
       lowRateState.accCount = 0;
 
       // Update active config
-      activeConfig = { ...payload, desiredRate, trigger: parseInt(triggerLevel.value) || 2048, invert: triggerLevel.invert };
+      activeConfig = { ...payload, desiredRate, filter: filterSelect.value, decode: parseInt(decodeSelect.value), trigger: parseInt(triggerLevel.value) || 2048, invert: triggerLevel.invert };
 
       // Save to localStorage
       localStorage.setItem('esp32_adc_config', JSON.stringify(activeConfig));
+    } else if (res.status === 400) {
+      // e.g. a decoder or filter that can't run at this rate, nothing was applied,
+      // so put the selects back to what's actually running
+      res.text().then(text => alert('Rejected: ' + text));
+      sampleRateSelect.value = String(activeConfig.desiredRate);
+      filterSelect.value = activeConfig.filter;
+      decodeSelect.value = String(activeConfig.decode);
     } else {
       alert('Error updating configuration');
     }
   }).catch(err => alert('Network error: ' + err));
 }
 
+/**
+ * Send just the decoder config. For the trigger level (the decoder thresholds
+ * follow it): re-sending everything would restart the ADC on every drag.
+ */
+function setDecode(retries = 5) {
+  fetch('/params', {
+    method: 'POST',
+    headers: { 'Content-Type': 'application/json' },
+    body: JSON.stringify({ decode: decodeConfig() })
+  }).then(res => {
+    if (res.status === 503 && retries > 0) {
+      window.setTimeout(() => setDecode(retries - 1), 50);
+    } else if (res.status === 400) {
+      res.text().then(text => alert('Rejected: ' + text));
+    } else if (!res.ok) {
+      alert('Error updating decoder');
+    }
+  }).catch(err => alert('Network error: ' + err));
+}
+
 /**
  * Load configuration from LocalStorage
  */
@@ -809,6 +1001,8 @@ function loadStoredConfig() {
       if (cfg.bit_width) bitWidthSelect.value = cfg.bit_width;
       if (cfg.atten !== undefined) attenSelect.value = cfg.atten;
       if (cfg.test_hz) testHzSelect.value = cfg.test_hz;
+      if (cfg.filter) filterSelect.value = cfg.filter;
+      if (typeof cfg.decode === 'number') decodeSelect.value = String(cfg.decode);
       if (cfg.invert) triggerLevel.invert = Boolean(cfg.invert);
       if (cfg.trigger) triggerLevel.value = String(cfg.trigger);
       triggerColor();
@@ -821,10 +1015,15 @@ function loadStoredConfig() {
 
 // Config Listeners
 if (reconnectBtn) reconnectBtn.addEventListener('click', connect);
-[sampleRateSelect, bitWidthSelect, attenSelect, testHzSelect].forEach(input => {
-  if (input) input.addEventListener('change', setParams)
+if (maskSelect) maskSelect.addEventListener('change', setMask);
+[sampleRateSelect, bitWidthSelect, attenSelect, testHzSelect, filterSelect, decodeSelect].forEach(input => {
+  if (input) input.addEventListener('change', () => setParams())
+});
+triggerLevel.addEventListener('change', () => {
+  localStorage.setItem('esp32_adc_config', JSON.stringify(activeConfig));
+  // Decoder thresholds follow the trigger level
+  if (decodeSelect.value !== '0') setDecode();
 });
-triggerLevel.addEventListener('change', () => localStorage.setItem('esp32_adc_config', JSON.stringify(activeConfig)));
 if (resetBtn) resetBtn.addEventListener('click', () => {
   localStorage.clear();
   window.location.reload();
@@ -888,5 +1087,7 @@ window.addEventListener('resize', resize);
 resize();
 setupWifiListeners();
 loadStoredConfig();
+updateDecodeOptions(Math.max(parseInt(sampleRateSelect.value) || 0, 20000));
+pollMask(); // a mask may still be running from before the reload
 connect();
 requestAnimationFrame(animationLoop);
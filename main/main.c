@@ -16,17 +16,25 @@
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_timer.h"
+#include "esp_cpu.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
 #include "wifi_manager.h"
-#include "nvs_flash.h"
+#include "udp_stream.h"
+#include "scope_codec.h"
+#include "scope_settings.h"
+#include "scope_boot.h"
+#include "scope_filter.h"
+#include "scope_decode.h"
+#include "scope_mask.h"
 
 static const char* TAG = "ESP-SCOPE";
 
 // --- WROOM-32D HARDWARE SETTINGS ---
 // Don't lower this. The classic ESP32 ADC driver freaks out/crashes below 20kHz.
-#define MIN_SAMPLE_RATE         20000 
+#define MIN_SAMPLE_RATE         SCOPE_MIN_SAMPLE_RATE
+#define MAX_SAMPLE_RATE         SCOPE_MAX_SAMPLE_RATE
 
 // Moved from GPIO 1 because that killed my Serial logs. 18 is safe.
 #define TEST_SIGNAL_PIN         18
@@ -41,6 +49,8 @@ static const char* TAG = "ESP-SCOPE";
 #define ADC_OUTPUT_TYPE         ADC_DIGI_OUTPUT_FORMAT_TYPE1
 #define ADC_GET_DATA(p_data)    ((p_data)->type1.data) 
 #define ADC_READ_LEN            4096
+// Type 1 results are 2 bytes each, so a full read is 2048 samples
+#define ADC_MAX_SAMPLES         ((int)(ADC_READ_LEN / sizeof(adc_digi_output_data_t)))
 
 // Board Specific Initialization (can be configured in the sdkconfig.defaults file)
 // #ifdef CONFIG_BOARD_SPECIFIC_INIT
@@ -60,14 +70,36 @@ static int client_fd = -1; // Socket for the connected browser
 static volatile bool need_reconfig = false;
 static bool is_ap_mode = false;
 
+// Filter chain config from /params, picked up by the ADC task (which owns the chain)
+static scope_filter_cfg_t s_filter_pending[SCOPE_FILTER_MAX_STAGES];
+static size_t s_filter_pending_n = 0;
+static volatile bool need_filter_reconfig = false;
+
+// Same deal for the serial decoder
+static scope_decode_cfg_t s_decode_pending;
+static volatile bool need_decode_reconfig = false;
+static volatile bool s_decode_raw = true; // keep sending samples while decoding
+
+// Mask test. Global (not in the ADC task) because GET /mask reads the results;
+// only the ADC task writes to it. Pending config comes from POST /mask.
+static scope_mask_t s_mask;
+static scope_mask_cfg_t s_mask_pending;
+static volatile bool need_mask_reconfig = false;
+static volatile bool need_mask_reset = false;
+
 // Defaults
 static uint32_t s_sample_rate = MIN_SAMPLE_RATE;
 static adc_atten_t s_atten = ADC_ATTEN_DB_12;
 static uint16_t s_test_hz = 100;
 
+// Boot-to-first-frame timing, esp_timer_get_time() counts from boot
+static int64_t s_t_first_sample = 0;
+static bool s_boot_reported = false;
+
 // Forward decls
 static void adc_init_hardware(adc_channel_t* channel, uint8_t channel_num);
 static void start_webserver(void);
+static void report_boot_timing(const char* via);
 
 // Just aligns buffer size to 4 bytes so DMA is happy
 static uint32_t calc_buffer_size(uint32_t rate) {
@@ -80,6 +112,83 @@ static uint32_t calc_buffer_size(uint32_t rate) {
     return (size + 3) & ~3;
 }
 
+static esp_err_t ws_send_binary(uint8_t* payload, size_t len) {
+    httpd_ws_frame_t ws_pkt = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_BINARY,
+        .payload = payload,
+        .len = len
+    };
+
+    // Async send is safer for high frequency
+    esp_err_t ws_ret = httpd_ws_send_frame_async(s_server, client_fd, &ws_pkt);
+
+    if (ws_ret == ESP_ERR_INVALID_ARG) {
+        // Client probably closed tab
+        client_fd = -1;
+    }
+    // If it's just busy, we drop the frame. It's fine for a scope.
+    return ws_ret;
+}
+
+#ifdef CONFIG_SCOPE_MASK_BENCH
+// Throughput of the mask compare kernel on this core, logged once at boot
+static void mask_bench(void) {
+    static uint16_t x[SCOPE_MASK_MAX_LEN], lo[SCOPE_MASK_MAX_LEN], span[SCOPE_MASK_MAX_LEN];
+    const int rounds = 32;
+    volatile uint32_t viol = 0;
+
+    for (int i = 0; i < SCOPE_MASK_MAX_LEN; i++) {
+        x[i] = 2048 + (i * 37) % 1500;
+        lo[i] = 1000;
+        span[i] = 2500;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int r = 0; r < rounds; r++) viol += scope_mask_compare(x, lo, span, SCOPE_MASK_MAX_LEN);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    float per_sample = (float)cycles / (rounds * SCOPE_MASK_MAX_LEN);
+    ESP_LOGI(TAG, "Mask bench %.2f cycles/sample, %.1f Msamples/s on one core",
+             per_sample, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / per_sample);
+}
+#endif
+
+#ifdef CONFIG_SCOPE_FILTER_BENCH
+// Cycles/sample for each filter type on this core, logged once at boot
+static void filter_bench(void) {
+    static const scope_filter_cfg_t cfgs[] = {
+        { .type = SCOPE_FILTER_LOWPASS, .freq_hz = 1000 },
+        { .type = SCOPE_FILTER_HIGHPASS, .freq_hz = 20 },
+        { .type = SCOPE_FILTER_NOTCH, .freq_hz = 50, .q = 10 },
+        { .type = SCOPE_FILTER_MOVING_AVG, .taps = 16 },
+    };
+    static const char* names[] = { "lowpass", "highpass", "notch", "avg16" };
+    static uint16_t buf[ADC_MAX_SAMPLES];
+    static scope_filter_chain_t chain;
+    const int rounds = 16;
+
+    for (int i = 0; i < ADC_MAX_SAMPLES; i++) buf[i] = 2048 + (i * 37) % 1500;
+
+    for (int t = 0; t < 5; t++) {
+        // t == 4: all four stages chained, i.e. the worst case config
+        size_t n = (t < 4) ? 1 : 4;
+        scope_filter_chain_init(&chain);
+        scope_filter_chain_set(&chain, (t < 4) ? &cfgs[t] : cfgs, n, 83333);
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (int r = 0; r < rounds; r++) scope_filter_chain_process(&chain, buf, ADC_MAX_SAMPLES);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        float per_sample = (float)cycles / (rounds * ADC_MAX_SAMPLES);
+        ESP_LOGI(TAG, "Filter bench %-8s %6.1f cycles/sample (max ~%" PRIu32 " ksps on one core)",
+                 (t < 4) ? names[t] : "chain4", per_sample,
+                 (uint32_t)(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000 / per_sample));
+    }
+}
+#endif
+
 static void adc_task(void* arg) {
     esp_err_t ret;
     uint32_t ret_num = 0;
@@ -87,6 +196,19 @@ static void adc_task(void* arg) {
     // Huge buffer -> moved to static so we don't smash the stack
     static uint8_t raw_data[ADC_READ_LEN] = {0};
     static int skip_count = 0;
+    static scope_filter_chain_t filter;
+    static scope_decoder_t decoder;
+    scope_filter_chain_init(&filter);
+    scope_decode_init(&decoder);
+    scope_mask_init(&s_mask);
+    uint32_t running_rate = s_sample_rate; // what the ADC was last started with
+
+#ifdef CONFIG_SCOPE_FILTER_BENCH
+    filter_bench();
+#endif
+#ifdef CONFIG_SCOPE_MASK_BENCH
+    mask_bench();
+#endif
     
     // Setup ADC on Ch0 (GPIO 36)
     adc_channel_t chans[1] = {ADC_CHANNEL_0};
@@ -104,49 +226,127 @@ static void adc_task(void* arg) {
             vTaskDelay(pdMS_TO_TICKS(20)); // Let the hardware settle
             adc_init_hardware(chans, 1);
             adc_continuous_start(adc_handle);
+            udp_stream_reconfig(s_sample_rate);
+            if (scope_filter_chain_active(&filter) && !scope_filter_chain_set_rate(&filter, s_sample_rate)) {
+                ESP_LOGW(TAG, "Filters don't fit %" PRIu32 " Hz, disabled", s_sample_rate);
+            }
+            if (scope_decode_active(&decoder)) {
+                scope_decode_cfg_t cfg = decoder.cfg;
+                if (!scope_decode_config(&decoder, &cfg, s_sample_rate)) {
+                    ESP_LOGW(TAG, "%" PRIu32 " baud is too fast for %" PRIu32 " Hz, decoder off", cfg.baud, s_sample_rate);
+                    scope_decode_init(&decoder);
+                }
+            }
+            // The mask is in samples, so old results don't mean much at a new rate.
+            // Only on an actual change: the page re-sends the same rate on every connect.
+            if (scope_mask_active(&s_mask) && s_sample_rate != running_rate) {
+                scope_mask_reset(&s_mask);
+                ESP_LOGW(TAG, "Rate changed, mask counters reset");
+            }
+            running_rate = s_sample_rate;
             need_reconfig = false;
         }
 
+        if (need_filter_reconfig) {
+            if (scope_filter_chain_set(&filter, s_filter_pending, s_filter_pending_n, s_sample_rate)) {
+                ESP_LOGI(TAG, "Filter chain: %d stage(s)", (int)s_filter_pending_n);
+            } else {
+                ESP_LOGW(TAG, "Bad filter config, keeping the old one");
+            }
+            // Cleared after the copy: /params won't touch s_filter_pending until then
+            need_filter_reconfig = false;
+        }
+
+        if (need_decode_reconfig) {
+            if (scope_decode_config(&decoder, &s_decode_pending, s_sample_rate)) {
+                ESP_LOGI(TAG, "Decoder: %s", scope_decode_active(&decoder) ? "UART" : "off");
+            } else {
+                ESP_LOGW(TAG, "Bad decoder config, keeping the old one");
+            }
+            // Same as the filters: cleared after the copy
+            need_decode_reconfig = false;
+        }
+
+        if (need_mask_reconfig) {
+            if (scope_mask_config(&s_mask, &s_mask_pending)) {
+                ESP_LOGI(TAG, "Mask: %s, %u samples", s_mask.mode == SCOPE_MASK_TEACH ? "teach" :
+                         scope_mask_active(&s_mask) ? "test" : "off", s_mask.len);
+            } else {
+                ESP_LOGW(TAG, "Bad mask config, keeping the old one");
+            }
+            // Cleared after the copy: POST /mask won't touch s_mask_pending until then
+            need_mask_reconfig = false;
+        }
+
+        if (need_mask_reset) {
+            need_mask_reset = false;
+            scope_mask_reset(&s_mask);
+        }
+
         ret = adc_continuous_read(adc_handle, raw_data, calc_buffer_size(s_sample_rate), &ret_num, 0);
 
         if (ret == ESP_OK) {
+            if (s_t_first_sample == 0) s_t_first_sample = esp_timer_get_time();
+
             // Only convert data if someone is actually watching
-            if (client_fd != -1) {
-                
+            if (client_fd != -1 || udp_stream_enabled() || scope_decode_active(&decoder) ||
+                scope_mask_active(&s_mask)) {
+                static uint16_t json_data[ADC_MAX_SAMPLES];
+                int idx = 0;
+
+                // ret_num can't be more than raw_data holds, but don't bet the statics on it
+                for (int i = 0; i + (int)sizeof(adc_digi_output_data_t) <= (int)ret_num && idx < ADC_MAX_SAMPLES;
+                     i += sizeof(adc_digi_output_data_t)) {
+                    adc_digi_output_data_t* p = (adc_digi_output_data_t*)&raw_data[i];
+                    // Using the Type 1 macro from top of file
+                    json_data[idx++] = (uint16_t)ADC_GET_DATA(p);
+                }
+
+                // Filter before anything goes out, so WS and UDP see the same signal
+                if (scope_filter_chain_active(&filter)) {
+                    scope_filter_chain_process(&filter, json_data, idx);
+                }
+
+                // Mask test runs on every frame too, that's the whole point of it
+                if (scope_mask_active(&s_mask)) {
+                    bool teaching = s_mask.mode == SCOPE_MASK_TEACH;
+                    scope_mask_feed(&s_mask, json_data, idx);
+                    if (teaching && s_mask.mode == SCOPE_MASK_TEST) ESP_LOGI(TAG, "Mask taught, testing");
+                }
+
+                // The decoder has to see every frame (a byte can span two), not just the
+                // ones we end up sending
+                if (scope_decode_active(&decoder)) {
+                    scope_decode_feed(&decoder, json_data, idx);
+                    if (client_fd == -1) scope_decode_clear_events(&decoder);
+                }
+
+                // UDP gets every frame. Non-blocking, so if WiFi can't keep up it
+                // just drops datagrams and the receiver reports the gap.
+                if (idx > 0 && udp_stream_enabled()) {
+                    if (udp_stream_send(json_data, idx, (uint32_t)esp_timer_get_time())) {
+                        report_boot_timing("UDP");
+                    }
+                }
+
                 // Throttle: Send every 2nd frame so WiFi doesn't choke
-                if (++skip_count < 2) {
+                if (client_fd == -1 || ++skip_count < 2) {
                     // Skip
                 } else {
                     skip_count = 0;
-                    
-                    static uint16_t json_data[ADC_READ_LEN / 4];
-                    int idx = 0;
-
-                    for (int i = 0; i < ret_num; i += sizeof(adc_digi_output_data_t)) {
-                        adc_digi_output_data_t* p = (adc_digi_output_data_t*)&raw_data[i];
-                        // Using the Type 1 macro from top of file
-                        json_data[idx++] = (uint16_t)ADC_GET_DATA(p);
+
+                    // Decoded bytes: a few bytes each instead of the whole waveform
+                    if (scope_decode_active(&decoder)) {
+                        static uint8_t ev_frame[SCOPE_DECODE_HDR_LEN + SCOPE_DECODE_MAX_EVENTS * SCOPE_DECODE_EVENT_LEN];
+                        size_t ev_len = scope_decode_take_events(&decoder, ev_frame, sizeof(ev_frame));
+                        if (ev_len > 0) ws_send_binary(ev_frame, ev_len);
                     }
 
-                    if (idx > 0) {
-                        httpd_ws_frame_t ws_pkt = {
-                            .final = true,
-                            .fragmented = false,
-                            .type = HTTPD_WS_TYPE_BINARY,
-                            .payload = (uint8_t*)json_data,
-                            .len = idx * sizeof(uint16_t)
-                        };
-
-                        // Async send is safer for high frequency
-                        esp_err_t ws_ret = httpd_ws_send_frame_async(s_server, client_fd, &ws_pkt);
-
-                        if (ws_ret != ESP_OK) {
-                            if (ws_ret == ESP_ERR_INVALID_ARG) {
-                                // Client probably closed tab
-                                client_fd = -1;
-                            }
-                            // If it's just busy, we drop the frame. It's fine for a scope.
-                        } else {
+                    if (idx > 0 && client_fd != -1 && (s_decode_raw || !scope_decode_active(&decoder))) {
+                        // Wire format is scope_codec.h. ESP32 is little-endian, so
+                        // json_data already *is* the encoded frame, no copy needed.
+                        if (ws_send_binary((uint8_t*)json_data, scope_codec_len(idx)) == ESP_OK) {
+                            report_boot_timing("WebSocket");
                             // Give the network stack a tiny break
                             vTaskDelay(pdMS_TO_TICKS(1)); 
                         }
@@ -160,6 +360,19 @@ static void adc_task(void* arg) {
     }
 }
 
+// One-shot log of how long boot took until data actually left the device
+static void report_boot_timing(const char* via) {
+    if (s_boot_reported) return;
+    s_boot_reported = true;
+
+    int64_t ip_us = wifi_manager_got_ip_time_us();
+    char ip_ms[16] = "n/a";
+    if (ip_us) snprintf(ip_ms, sizeof(ip_ms), "%lld ms", ip_us / 1000);
+
+    ESP_LOGI(TAG, "Boot timing: first sample %lld ms, got IP %s, first frame (%s) %lld ms",
+             s_t_first_sample / 1000, ip_ms, via, esp_timer_get_time() / 1000);
+}
+
 static void adc_init_hardware(adc_channel_t* channel, uint8_t channel_num) {
     uint32_t frame_size = calc_buffer_size(s_sample_rate);
     
@@ -251,6 +464,7 @@ static void ui_task() {
             if ((esp_timer_get_time() - press_start) > 3000000) {
                  ESP_LOGW(TAG, "Factory Reset...");
                  wifi_manager_erase_config();
+                 scope_settings_erase();
                  esp_restart();
             }
         } else {
@@ -259,25 +473,41 @@ static void ui_task() {
     }
 }
 
-void app_main(void) {
-    // 1. Setup NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES) {
-        nvs_flash_erase();
-        nvs_flash_init();
-    }
+// Boot steps for scope_boot(), which decides the order
+static void boot_apply_settings(const scope_settings_t* s) {
+    s_sample_rate = s->sample_rate;
+    s_atten = (adc_atten_t)s->atten;
+    s_test_hz = s->test_hz;
+    ESP_LOGI(TAG, "Settings: %" PRIu32 " Hz, atten %d, test %u Hz", s_sample_rate, s_atten, s_test_hz);
+}
 
-    // 2. Start WiFi (Manager handles the AP/STA logic)
-    is_ap_mode = wifi_manager_init_wifi();
+static void boot_test_signal(const scope_settings_t* s) {
+    enable_test_signal(s->test_hz);
+}
 
-    // 3. Start hardware
-    enable_test_signal(s_test_hz);
-    
+static void boot_adc(void) {
     // Lower priority than WiFi so we don't starve the network
     // !!! FIXED: Stack was 4096 (too small), changed to 6144 to stop crashes !!!
     xTaskCreate(adc_task, "adc_reader", 6144, NULL, 2, NULL);
-    
-    start_webserver();
+}
+
+static void boot_udp(const scope_settings_t* s) {
+    udp_stream_init(s->sample_rate);
+}
+
+void app_main(void) {
+    static const scope_boot_ops_t ops = {
+        .apply_settings = boot_apply_settings,
+        .start_test_signal = boot_test_signal,
+        .start_adc = boot_adc,
+        .start_wifi = wifi_manager_init_wifi, // Manager handles the AP/STA logic
+        .start_udp = boot_udp,
+        .start_webserver = start_webserver,
+    };
+
+    // Defaults, overridden by whatever the browser set before the reboot
+    scope_settings_t settings = { s_sample_rate, s_atten, s_test_hz };
+    is_ap_mode = scope_boot(&settings, &ops);
     
     // UI loop (LEDs/Buttons) - just running it here in main
     ui_task(); 
@@ -314,22 +544,136 @@ static esp_err_t ws_handler(httpd_req_t* req) {
 }
 
 static esp_err_t params_handler(httpd_req_t* req) {
-    char buf[200];
+    char buf[512]; // room for a filter list
     int len = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (len > 0) {
         buf[len] = 0;
         cJSON* root = cJSON_Parse(buf);
         if (root) {
+            // The ADC task hasn't copied the last filter/decoder/UDP change yet, writing
+            // the pending config now could tear it. The page retries on 503.
+            if ((cJSON_GetObjectItem(root, "filters") && need_filter_reconfig) ||
+                (cJSON_GetObjectItem(root, "decode") && need_decode_reconfig) ||
+                (cJSON_GetObjectItem(root, "udp_port") && udp_stream_target_pending())) {
+                cJSON_Delete(root);
+                httpd_resp_set_status(req, "503 Service Unavailable");
+                return httpd_resp_send(req, "Busy", HTTPD_RESP_USE_STRLEN);
+            }
+
+            // {"decode": {"proto": "uart", "baud": 9600, "bits": 8, "parity": "none", "stop": 1,
+            //             "invert": false, "lo": 1600, "hi": 2400, "raw": false}}
+            // lo/hi are the hysteresis thresholds in ADC codes. raw=false sends only the
+            // decoded bytes, not the waveform. {"decode": {"proto": "off"}} stops it.
+            // Parsed (and checked against the new rate) before anything is applied, so a
+            // decoder that can't run gets a 400 instead of a silent "OK"
+            scope_decode_cfg_t dec_cfg = s_decode_pending; // i.e. what's running
+            bool dec_raw = s_decode_raw;
+            cJSON* dec = cJSON_GetObjectItem(root, "decode");
+            if (cJSON_IsObject(dec)) {
+                cJSON* proto = cJSON_GetObjectItem(dec, "proto");
+                cJSON* baud = cJSON_GetObjectItem(dec, "baud");
+                cJSON* bits = cJSON_GetObjectItem(dec, "bits");
+                cJSON* parity = cJSON_GetObjectItem(dec, "parity");
+                cJSON* stop = cJSON_GetObjectItem(dec, "stop");
+                cJSON* lo = cJSON_GetObjectItem(dec, "lo");
+                cJSON* hi = cJSON_GetObjectItem(dec, "hi");
+                cJSON* raw = cJSON_GetObjectItem(dec, "raw");
+                const char* par = cJSON_IsString(parity) ? parity->valuestring : "none";
+
+                dec_cfg = (scope_decode_cfg_t){
+                    .proto = (cJSON_IsString(proto) && strcmp(proto->valuestring, "uart") == 0) ? SCOPE_DECODE_UART : SCOPE_DECODE_OFF,
+                    .thr_lo = cJSON_IsNumber(lo) ? lo->valueint : 1600,
+                    .thr_hi = cJSON_IsNumber(hi) ? hi->valueint : 2400,
+                    .invert = cJSON_IsTrue(cJSON_GetObjectItem(dec, "invert")),
+                    .baud = cJSON_IsNumber(baud) ? baud->valueint : 9600,
+                    .data_bits = cJSON_IsNumber(bits) ? bits->valueint : 8,
+                    .parity = (strcmp(par, "even") == 0) ? SCOPE_PARITY_EVEN : (strcmp(par, "odd") == 0) ? SCOPE_PARITY_ODD : SCOPE_PARITY_NONE,
+                    .stop_bits = cJSON_IsNumber(stop) ? stop->valueint : 1,
+                };
+                dec_raw = !cJSON_IsBool(raw) || cJSON_IsTrue(raw);
+            }
+
             cJSON* rate = cJSON_GetObjectItem(root, "sample_rate");
+            uint32_t new_rate = s_sample_rate;
             if (rate) {
-                // Safety clamp
-                s_sample_rate = (rate->valueint < MIN_SAMPLE_RATE) ? MIN_SAMPLE_RATE : rate->valueint;
+                // Safety clamp, both ways: this gets saved and used at the next boot too
+                int r = rate->valueint;
+                new_rate = (r < MIN_SAMPLE_RATE) ? MIN_SAMPLE_RATE : (r > MAX_SAMPLE_RATE) ? MAX_SAMPLE_RATE : r;
+            }
+
+            // Also covers a rate change alone, which would otherwise switch a running
+            // decoder off behind the page's back
+            if (!scope_decode_check(&dec_cfg, new_rate)) {
+                char msg[96];
+                snprintf(msg, sizeof(msg), "Can't decode %" PRIu32 " baud at %" PRIu32 " Hz (needs %d samples/bit)",
+                         dec_cfg.baud, new_rate, SCOPE_DECODE_MIN_SAMPLES_PER_BIT);
+                cJSON_Delete(root);
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+            }
+
+            // {"filters": [{"type": "notch", "hz": 50, "q": 10}, {"type": "avg", "taps": 8}]}
+            // Empty array turns filtering off. Types: lowpass, highpass, notch, avg.
+            // Same as the decoder: parsed and designed at the new rate up front, so a
+            // chain that can't run is a 400 and nothing gets applied.
+            scope_filter_cfg_t flt_cfg[SCOPE_FILTER_MAX_STAGES];
+            size_t flt_n = s_filter_pending_n; // i.e. what's running
+            memcpy(flt_cfg, s_filter_pending, sizeof(flt_cfg));
+            cJSON* filters = cJSON_GetObjectItem(root, "filters");
+            if (cJSON_IsArray(filters)) {
+                int n = cJSON_GetArraySize(filters);
+                if (n > SCOPE_FILTER_MAX_STAGES) {
+                    char msg[48];
+                    snprintf(msg, sizeof(msg), "At most %d filter stages", SCOPE_FILTER_MAX_STAGES);
+                    cJSON_Delete(root);
+                    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+                }
+
+                for (int i = 0; i < n; i++) {
+                    cJSON* f = cJSON_GetArrayItem(filters, i);
+                    cJSON* type = cJSON_GetObjectItem(f, "type");
+                    cJSON* hz = cJSON_GetObjectItem(f, "hz");
+                    cJSON* q = cJSON_GetObjectItem(f, "q");
+                    cJSON* taps = cJSON_GetObjectItem(f, "taps");
+
+                    flt_cfg[i] = (scope_filter_cfg_t){
+                        .type = scope_filter_type_from_name(cJSON_IsString(type) ? type->valuestring : NULL),
+                        .freq_hz = cJSON_IsNumber(hz) ? (float)hz->valuedouble : 0,
+                        .q = cJSON_IsNumber(q) ? (float)q->valuedouble : 0,
+                        .taps = cJSON_IsNumber(taps) ? (uint16_t)taps->valueint : 0,
+                    };
+                    if (flt_cfg[i].type == SCOPE_FILTER_NONE) {
+                        char msg[64];
+                        snprintf(msg, sizeof(msg), "Unknown filter type '%.24s'",
+                                 cJSON_IsString(type) ? type->valuestring : "");
+                        cJSON_Delete(root);
+                        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+                    }
+                }
+                flt_n = n;
+            }
+
+            // One stage at a time so the page can be told which one. Static: ~300 bytes
+            // per stage, and httpd runs one handler at a time.
+            static scope_filter_chain_t s_filter_check;
+            for (size_t i = 0; i < flt_n; i++) {
+                if (!scope_filter_chain_set(&s_filter_check, &flt_cfg[i], 1, new_rate)) {
+                    char msg[112];
+                    snprintf(msg, sizeof(msg), "Filter %d can't run at %" PRIu32 " Hz (needs hz below %" PRIu32
+                             ", avg taps 1..%d)", (int)i + 1, new_rate, new_rate / 2, SCOPE_FILTER_MAX_TAPS);
+                    cJSON_Delete(root);
+                    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+                }
+            }
+
+            if (rate) {
+                s_sample_rate = new_rate;
                 need_reconfig = true;
             }
             
             cJSON* atten = cJSON_GetObjectItem(root, "atten");
             if (atten) { 
-                s_atten = (adc_atten_t)atten->valueint; 
+                int a = atten->valueint;
+                s_atten = (adc_atten_t)((a < 0) ? 0 : (a > SCOPE_MAX_ATTEN) ? SCOPE_MAX_ATTEN : a);
                 need_reconfig = true; 
             }
             
@@ -338,6 +682,30 @@ static esp_err_t params_handler(httpd_req_t* req) {
                 s_test_hz = thz->valueint; 
                 enable_test_signal(s_test_hz); 
             }
+
+            if (cJSON_IsArray(filters)) {
+                memcpy(s_filter_pending, flt_cfg, sizeof(flt_cfg));
+                s_filter_pending_n = flt_n;
+                need_filter_reconfig = true;
+            }
+
+            if (cJSON_IsObject(dec)) {
+                s_decode_pending = dec_cfg;
+                s_decode_raw = dec_raw;
+                need_decode_reconfig = true;
+            }
+
+            if (rate || atten || thz) {
+                scope_settings_t cur = { s_sample_rate, s_atten, s_test_hz };
+                scope_settings_save(&cur);
+            }
+
+            // {"udp_host": "192.168.1.50", "udp_port": 5005}, port 0 stops the stream
+            cJSON* uport = cJSON_GetObjectItem(root, "udp_port");
+            if (cJSON_IsNumber(uport)) {
+                cJSON* uhost = cJSON_GetObjectItem(root, "udp_host");
+                udp_stream_set_target(cJSON_IsString(uhost) ? uhost->valuestring : NULL, uport->valueint);
+            }
             cJSON_Delete(root);
         }
     }
@@ -345,6 +713,149 @@ static esp_err_t params_handler(httpd_req_t* req) {
     return ESP_OK;
 }
 
+// Mask envelopes are too big for the /params buffer: up to 2 x 1024 codes
+#define MASK_BODY_MAX 16384
+
+static uint16_t clamp_code(int v) {
+    return (v < 0) ? 0 : (v > SCOPE_CODEC_MAX_CODE) ? SCOPE_CODEC_MAX_CODE : v;
+}
+
+// Number -> same limit for every offset, array -> one per offset
+static bool mask_limits(cJSON* item, uint16_t* out, uint16_t len) {
+    if (cJSON_IsNumber(item)) {
+        for (int i = 0; i < len; i++) out[i] = clamp_code(item->valueint);
+        return true;
+    }
+    if (!cJSON_IsArray(item) || cJSON_GetArraySize(item) != len) return false;
+
+    int i = 0;
+    cJSON* v;
+    cJSON_ArrayForEach(v, item) {
+        if (!cJSON_IsNumber(v)) return false;
+        out[i++] = clamp_code(v->valueint);
+    }
+    return true;
+}
+
+// POST /mask
+// {"mode": "test", "trigger": "falling", "level": 2048, "hyst": 50, "pre": 50,
+//  "lo": [...], "hi": [...]}     lo/hi: ADC codes, one per sample, or a single number
+// {"mode": "teach", "trigger": "falling", "level": 2048, "len": 500, "pre": 50, "tol": 100}
+// {"mode": "test", "trigger": "none", "len": 1000, "lo": 500, "hi": 3500}   plain limits
+// {"mode": "off"}, or {"reset": true} to just zero the counters
+static esp_err_t mask_post_handler(httpd_req_t* req) {
+    if (req->content_len == 0 || req->content_len > MASK_BODY_MAX) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad mask size");
+    }
+    if (need_mask_reconfig) {
+        // ADC task hasn't picked up the last one yet
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "Busy", HTTPD_RESP_USE_STRLEN);
+    }
+
+    char* buf = malloc(req->content_len + 1);
+    if (!buf) return httpd_resp_send_500(req);
+
+    size_t got = 0;
+    while (got < req->content_len) {
+        int r = httpd_req_recv(req, buf + got, req->content_len - got);
+        if (r == HTTPD_SOCK_ERR_TIMEOUT) continue;
+        if (r <= 0) {
+            free(buf);
+            return ESP_FAIL;
+        }
+        got += r;
+    }
+    buf[got] = 0;
+
+    cJSON* root = cJSON_Parse(buf);
+    free(buf);
+    if (!root) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad JSON");
+
+    if (cJSON_IsTrue(cJSON_GetObjectItem(root, "reset"))) {
+        need_mask_reset = true;
+        cJSON_Delete(root);
+        return httpd_resp_send(req, "OK", 2);
+    }
+
+    cJSON* mode = cJSON_GetObjectItem(root, "mode");
+    cJSON* trig = cJSON_GetObjectItem(root, "trigger");
+    cJSON* level = cJSON_GetObjectItem(root, "level");
+    cJSON* hyst = cJSON_GetObjectItem(root, "hyst");
+    cJSON* len = cJSON_GetObjectItem(root, "len");
+    cJSON* pre = cJSON_GetObjectItem(root, "pre");
+    cJSON* tol = cJSON_GetObjectItem(root, "tol");
+    cJSON* lo = cJSON_GetObjectItem(root, "lo");
+    cJSON* hi = cJSON_GetObjectItem(root, "hi");
+    const char* m = cJSON_IsString(mode) ? mode->valuestring : "off";
+    const char* t = cJSON_IsString(trig) ? trig->valuestring : "none";
+
+    scope_mask_cfg_t* cfg = &s_mask_pending;
+    cfg->mode = (strcmp(m, "test") == 0) ? SCOPE_MASK_TEST : (strcmp(m, "teach") == 0) ? SCOPE_MASK_TEACH : SCOPE_MASK_OFF;
+    cfg->trigger = (strcmp(t, "rising") == 0) ? SCOPE_MASK_TRIG_RISING : (strcmp(t, "falling") == 0) ? SCOPE_MASK_TRIG_FALLING : SCOPE_MASK_TRIG_NONE;
+    cfg->level = cJSON_IsNumber(level) ? level->valueint : 2048;
+    cfg->hyst = cJSON_IsNumber(hyst) ? hyst->valueint : 50;
+    cfg->pre = cJSON_IsNumber(pre) ? pre->valueint : 0;
+    cfg->tol = cJSON_IsNumber(tol) ? tol->valueint : 100;
+    // Envelope arrays set the length, otherwise it has to be given
+    cfg->len = cJSON_IsArray(lo) ? cJSON_GetArraySize(lo) : cJSON_IsNumber(len) ? len->valueint : 0;
+    if (cfg->len > SCOPE_MASK_MAX_LEN) cfg->len = 0;
+
+    bool ok = cfg->mode != SCOPE_MASK_TEST ||
+              (mask_limits(lo, cfg->lo, cfg->len) && mask_limits(hi, cfg->hi, cfg->len));
+    cJSON_Delete(root);
+
+    if (!ok || (cfg->mode != SCOPE_MASK_OFF && cfg->len == 0)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad mask");
+    }
+    need_mask_reconfig = true;
+    return httpd_resp_send(req, "OK", 2);
+}
+
+// GET /mask            counters as JSON, cheap enough to poll
+// GET /mask?captures=1 plus the failing waveforms (samples in ADC codes)
+static esp_err_t mask_get_handler(httpd_req_t* req) {
+    static const char* modes[] = { "off", "test", "teach" };
+    char query[32], val[8];
+    bool with_samples = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                        httpd_query_key_value(query, "captures", val, sizeof(val)) == ESP_OK &&
+                        strcmp(val, "0") != 0;
+
+    // Chunked, the captures alone can be ~20KB of JSON
+    char out[256];
+    httpd_resp_set_type(req, "application/json");
+    uint8_t n = s_mask.num_captures;
+    snprintf(out, sizeof(out),
+             "{\"mode\":\"%s\",\"sample_rate\":%" PRIu32 ",\"len\":%u,\"pre\":%u,"
+             "\"tested\":%" PRIu32 ",\"passed\":%" PRIu32 ",\"failed\":%" PRIu32 ",\"captures\":[",
+             modes[s_mask.mode], s_sample_rate, s_mask.len, s_mask.pre,
+             s_mask.tested, s_mask.passed, s_mask.failed);
+    httpd_resp_sendstr_chunk(req, out);
+
+    for (int i = 0; i < n; i++) {
+        const scope_mask_capture_t* c = &s_mask.captures[i];
+        snprintf(out, sizeof(out), "%s{\"t\":%" PRIu32 ",\"first_fail\":%u,\"violations\":%u",
+                 i ? "," : "", c->t, c->first_fail, c->violations);
+        httpd_resp_sendstr_chunk(req, out);
+        if (with_samples) {
+            size_t pos = 0;
+            pos += snprintf(out, sizeof(out), ",\"samples\":[");
+            for (int j = 0; j < s_mask.len; j++) {
+                pos += snprintf(out + pos, sizeof(out) - pos, "%s%u", j ? "," : "", c->samples[j]);
+                if (pos > sizeof(out) - 8) {
+                    httpd_resp_sendstr_chunk(req, out);
+                    pos = 0;
+                }
+            }
+            snprintf(out + pos, sizeof(out) - pos, "]");
+            httpd_resp_sendstr_chunk(req, out);
+        }
+        httpd_resp_sendstr_chunk(req, "}");
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
 static esp_err_t serve_index(httpd_req_t* req) {
     httpd_resp_set_type(req, "text/html");
     return httpd_resp_send(req, (const char*)index_html_start, index_html_end - index_html_start);
@@ -367,11 +878,15 @@ static void start_webserver(void) {
         httpd_uri_t u_js = { .uri = "/index.js", .method = HTTP_GET, .handler = serve_js };
         httpd_uri_t u_ws = { .uri = "/signal", .method = HTTP_GET, .handler = ws_handler, .is_websocket = true };
         httpd_uri_t u_api = { .uri = "/params", .method = HTTP_POST, .handler = params_handler };
+        httpd_uri_t u_mask = { .uri = "/mask", .method = HTTP_POST, .handler = mask_post_handler };
+        httpd_uri_t u_mask_get = { .uri = "/mask", .method = HTTP_GET, .handler = mask_get_handler };
 
         httpd_register_uri_handler(s_server, &u_idx);
         httpd_register_uri_handler(s_server, &u_js);
         httpd_register_uri_handler(s_server, &u_ws);
         httpd_register_uri_handler(s_server, &u_api);
+        httpd_register_uri_handler(s_server, &u_mask);
+        httpd_register_uri_handler(s_server, &u_mask_get);
         
         // Let the wifi manager add its own pages too
         wifi_manager_register_uri(s_server);
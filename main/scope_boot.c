@@ -0,0 +1,22 @@
+#include "scope_boot.h"
+
+#include "nvs_flash.h"
+
+bool scope_boot(scope_settings_t* s, const scope_boot_ops_t* ops) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        nvs_flash_init();
+    }
+
+    scope_settings_restore(s);
+    ops->apply_settings(s);
+
+    ops->start_test_signal(s);
+    ops->start_adc();
+
+    bool ap_mode = ops->start_wifi();
+    ops->start_udp(s);
+    ops->start_webserver();
+    return ap_mode;
+}
@@ -0,0 +1,28 @@
+#ifndef SCOPE_BOOT_H
+#define SCOPE_BOOT_H
+
+// Boot order, kept out of app_main so a host build can check it with fake steps.
+// Only nvs_flash.h from IDF (via scope_settings).
+//
+//   1. NVS (erased and re-inited if it's full or from a newer IDF)
+//   2. last settings restored on top of the defaults
+//   3. test signal + ADC task: sampling doesn't need WiFi, so it runs while we associate
+//   4. WiFi, then UDP (its socket needs lwip up), then the web server
+
+#include <stdbool.h>
+#include "scope_settings.h"
+
+typedef struct {
+    void (*apply_settings)(const scope_settings_t* s); // copy into whatever the ADC task reads
+    void (*start_test_signal)(const scope_settings_t* s);
+    void (*start_adc)(void);
+    bool (*start_wifi)(void);                          // true = AP (provisioning) mode
+    void (*start_udp)(const scope_settings_t* s);
+    void (*start_webserver)(void);
+} scope_boot_ops_t;
+
+// s holds the defaults going in and what the device runs with coming out.
+// Returns what start_wifi() returned.
+bool scope_boot(scope_settings_t* s, const scope_boot_ops_t* ops);
+
+#endif // SCOPE_BOOT_H
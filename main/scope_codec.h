@@ -0,0 +1,46 @@
+#ifndef SCOPE_CODEC_H
+#define SCOPE_CODEC_H
+
+// Sample payload codec. Both the /signal WebSocket frames and the UDP datagram
+// payloads are a flat array of little-endian uint16, one 12-bit ADC code each.
+// Header-only and IDF-free so the Linux tools decode with the exact same code.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SCOPE_CODEC_BYTES_PER_SAMPLE 2
+#define SCOPE_CODEC_MAX_CODE         4095
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SCOPE_CODEC_NATIVE 1 // ESP32 and x86/ARM Linux: wire format == memory format
+#else
+#define SCOPE_CODEC_NATIVE 0
+#endif
+
+static inline size_t scope_codec_len(size_t n_samples) {
+    return n_samples * SCOPE_CODEC_BYTES_PER_SAMPLE;
+}
+
+static inline void scope_codec_encode(uint8_t* out, const uint16_t* samples, size_t n) {
+#if SCOPE_CODEC_NATIVE
+    memcpy(out, samples, n * SCOPE_CODEC_BYTES_PER_SAMPLE);
+#else
+    for (size_t i = 0; i < n; i++) {
+        out[2 * i] = samples[i] & 0xff;
+        out[2 * i + 1] = samples[i] >> 8;
+    }
+#endif
+}
+
+static inline void scope_codec_decode(uint16_t* samples, const uint8_t* in, size_t n) {
+#if SCOPE_CODEC_NATIVE
+    memcpy(samples, in, n * SCOPE_CODEC_BYTES_PER_SAMPLE);
+#else
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = (uint16_t)(in[2 * i] | (in[2 * i + 1] << 8));
+    }
+#endif
+}
+
+#endif // SCOPE_CODEC_H
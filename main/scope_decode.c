@@ -0,0 +1,186 @@
+#include "scope_decode.h"
+
+#include <string.h>
+
+void scope_decode_init(scope_decoder_t* d) {
+    memset(d, 0, sizeof(*d));
+}
+
+bool scope_decode_check(const scope_decode_cfg_t* cfg, uint32_t sample_rate) {
+    if (cfg->proto == SCOPE_DECODE_OFF) return true;
+    if (cfg->proto != SCOPE_DECODE_UART) return false;
+    if (cfg->baud == 0 || sample_rate / cfg->baud < SCOPE_DECODE_MIN_SAMPLES_PER_BIT) return false;
+    if (cfg->data_bits < 5 || cfg->data_bits > 9) return false;
+    if (cfg->stop_bits < 1 || cfg->stop_bits > 2) return false;
+    if (cfg->thr_lo > cfg->thr_hi) return false;
+    return true;
+}
+
+bool scope_decode_config(scope_decoder_t* d, const scope_decode_cfg_t* cfg, uint32_t sample_rate) {
+    if (!scope_decode_check(cfg, sample_rate)) return false;
+    if (cfg->proto == SCOPE_DECODE_OFF) {
+        scope_decode_init(d);
+        return true;
+    }
+
+    scope_decode_init(d);
+    d->cfg = *cfg;
+    d->sample_rate = sample_rate;
+    d->bit_q16 = (uint32_t)(((uint64_t)sample_rate << 16) / cfg->baud);
+    // Assume the line starts idle so the first real start bit is a falling edge
+    d->level = 1;
+    d->state = UART_IDLE;
+    return true;
+}
+
+static void emit(scope_decoder_t* d) {
+    if (d->num_events == SCOPE_DECODE_MAX_EVENTS) {
+        d->overflow = true;
+        return;
+    }
+    uint8_t flags = d->flags;
+    if (d->overflow) {
+        flags |= SCOPE_DECODE_OVERFLOW;
+        d->overflow = false;
+    }
+    d->events[d->num_events++] = (scope_decode_event_t){
+        .t = d->start,
+        .data = d->shift,
+        .flags = flags,
+        .proto = SCOPE_DECODE_UART,
+    };
+}
+
+// Center of bit n (0 = start bit) relative to the start edge
+static uint32_t bit_center(const scope_decoder_t* d, uint8_t n) {
+    return d->start + (uint32_t)(((uint64_t)(2 * n + 1) * d->bit_q16) >> 17);
+}
+
+// Called once per bit, at its center
+static void uart_bit(scope_decoder_t* d, uint8_t level) {
+    const uint8_t data_bits = d->cfg.data_bits;
+    const uint8_t parity_bits = d->cfg.parity != SCOPE_PARITY_NONE;
+    const uint8_t b = d->bit;
+
+    if (b == 0) {
+        // Start bit gone by mid-bit: that edge was a glitch
+        if (level) {
+            d->state = UART_IDLE;
+            return;
+        }
+    } else if (b <= data_bits) {
+        d->shift |= (uint16_t)level << (b - 1); // LSB first
+        d->ones += level;
+    } else if (parity_bits && b == data_bits + 1) {
+        d->ones += level;
+        bool odd = d->ones & 1;
+        if ((d->cfg.parity == SCOPE_PARITY_EVEN && odd) || (d->cfg.parity == SCOPE_PARITY_ODD && !odd)) {
+            d->flags |= SCOPE_DECODE_ERR_PARITY;
+        }
+    } else {
+        if (!level) {
+            d->flags |= SCOPE_DECODE_ERR_FRAMING;
+            if (d->shift == 0 && d->ones == 0) d->flags |= SCOPE_DECODE_BREAK;
+            emit(d);
+            // Don't take the still-low line as the next start bit
+            d->state = UART_WAIT_HIGH;
+            return;
+        }
+        if (b == data_bits + parity_bits + d->cfg.stop_bits) {
+            emit(d);
+            d->state = UART_IDLE;
+            return;
+        }
+    }
+
+    d->bit++;
+    d->target = bit_center(d, d->bit);
+}
+
+static void uart_feed(scope_decoder_t* d, const uint16_t* samples, size_t n) {
+    const uint16_t lo = d->cfg.thr_lo, hi = d->cfg.thr_hi;
+    const uint8_t inv = d->cfg.invert;
+    uint8_t level = d->level;
+    uint32_t idx = d->idx;
+
+    for (size_t i = 0; i < n; i++, idx++) {
+        uint16_t v = samples[i];
+        uint8_t prev = level;
+
+        // Hysteresis: in the dead band we keep whatever we had
+        if (v > hi) {
+            level = 1 ^ inv;
+        } else if (v < lo) {
+            level = 0 ^ inv;
+        }
+
+        switch (d->state) {
+            case UART_IDLE:
+                if (prev && !level) {
+                    d->state = UART_BITS;
+                    d->start = idx;
+                    d->bit = 0;
+                    d->shift = 0;
+                    d->ones = 0;
+                    d->flags = 0;
+                    d->target = bit_center(d, 0);
+                }
+                break;
+            case UART_BITS:
+                if ((int32_t)(idx - d->target) >= 0) uart_bit(d, level);
+                break;
+            case UART_WAIT_HIGH:
+                if (level) d->state = UART_IDLE;
+                break;
+        }
+    }
+
+    d->level = level;
+    d->idx = idx;
+}
+
+void scope_decode_feed(scope_decoder_t* d, const uint16_t* samples, size_t n) {
+    if (d->cfg.proto == SCOPE_DECODE_UART) uart_feed(d, samples, n);
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+size_t scope_decode_take_events(scope_decoder_t* d, uint8_t* out, size_t out_len) {
+    size_t n = d->num_events;
+    if (n == 0) return 0;
+    if (SCOPE_DECODE_HDR_LEN + n * SCOPE_DECODE_EVENT_LEN > out_len) {
+        n = (out_len - SCOPE_DECODE_HDR_LEN) / SCOPE_DECODE_EVENT_LEN;
+    }
+
+    put16(out, SCOPE_DECODE_MAGIC);
+    put16(out + 2, (uint16_t)n);
+    put32(out + 4, d->sample_rate);
+
+    uint8_t* p = out + SCOPE_DECODE_HDR_LEN;
+    for (size_t i = 0; i < n; i++, p += SCOPE_DECODE_EVENT_LEN) {
+        put32(p, d->events[i].t);
+        put16(p + 4, d->events[i].data);
+        p[6] = d->events[i].flags;
+        p[7] = d->events[i].proto;
+    }
+
+    // Anything that didn't fit goes out next time
+    d->num_events -= (uint16_t)n;
+    memmove(d->events, d->events + n, d->num_events * sizeof(d->events[0]));
+    return SCOPE_DECODE_HDR_LEN + n * SCOPE_DECODE_EVENT_LEN;
+}
+
+void scope_decode_clear_events(scope_decoder_t* d) {
+    d->num_events = 0;
+    d->overflow = false;
+}
@@ -0,0 +1,115 @@
+#ifndef SCOPE_DECODE_H
+#define SCOPE_DECODE_H
+
+// Streaming serial decoder: thresholds ADC codes with hysteresis and decodes
+// UART bytes incrementally, frame after frame, without ever buffering the
+// waveform. Plain C (no IDF headers) like the other scope_* modules.
+//
+// Only UART for now: the firmware samples a single ADC channel, and I2C/SPI
+// need clock + data (+ CS) captured together.
+//
+// Events go to the client as a binary WebSocket frame:
+//   u16 magic      SCOPE_DECODE_MAGIC (> 4095, so it can't be a sample frame)
+//   u16 count
+//   u32 sample_rate
+//   count x { u32 sample_index (start bit edge), u16 data, u8 flags, u8 proto }
+// all little-endian.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCOPE_DECODE_MAGIC       0xDEC0
+#define SCOPE_DECODE_HDR_LEN     8
+#define SCOPE_DECODE_EVENT_LEN   8
+#define SCOPE_DECODE_MAX_EVENTS  256
+
+// Below ~3 samples per bit the mid-bit sample point is mostly luck
+#define SCOPE_DECODE_MIN_SAMPLES_PER_BIT 3
+
+// event flags
+#define SCOPE_DECODE_ERR_FRAMING 0x01 // stop bit was low
+#define SCOPE_DECODE_ERR_PARITY  0x02
+#define SCOPE_DECODE_BREAK       0x04 // all zero incl. stop bit
+#define SCOPE_DECODE_OVERFLOW    0x08 // events were dropped before this one
+
+typedef enum {
+    SCOPE_DECODE_OFF = 0,
+    SCOPE_DECODE_UART,
+} scope_decode_proto_t;
+
+typedef enum {
+    SCOPE_PARITY_NONE = 0,
+    SCOPE_PARITY_EVEN,
+    SCOPE_PARITY_ODD,
+} scope_parity_t;
+
+typedef struct {
+    scope_decode_proto_t proto;
+    uint16_t thr_lo;     // below -> 0
+    uint16_t thr_hi;     // above -> 1, in between keeps the last level
+    bool invert;         // idle-low line (e.g. after an inverting level shifter)
+    uint32_t baud;
+    uint8_t data_bits;   // 5..9
+    scope_parity_t parity;
+    uint8_t stop_bits;   // 1 or 2
+} scope_decode_cfg_t;
+
+typedef struct {
+    uint32_t t;          // sample index of the start bit edge
+    uint16_t data;
+    uint8_t flags;
+    uint8_t proto;
+} scope_decode_event_t;
+
+typedef enum {
+    UART_IDLE,       // waiting for a falling edge
+    UART_BITS,       // inside a character
+    UART_WAIT_HIGH,  // after a framing error/break: wait for the line to recover
+} scope_uart_state_t;
+
+typedef struct {
+    scope_decode_cfg_t cfg;
+    uint32_t sample_rate;
+    uint32_t bit_q16;     // samples per bit, Q16
+
+    // Running across frames
+    uint32_t idx;         // sample index of the next input sample
+    uint8_t level;        // thresholded (and inverted) line level
+    scope_uart_state_t state;
+    uint32_t start;       // sample index of the start edge
+    uint32_t target;      // sample index of the next bit center
+    uint8_t bit;          // 0 = start bit, then data, parity, stop
+    uint16_t shift;
+    uint8_t ones;         // data + parity ones, for the parity check
+    uint8_t flags;
+
+    scope_decode_event_t events[SCOPE_DECODE_MAX_EVENTS];
+    uint16_t num_events;
+    bool overflow;
+} scope_decoder_t;
+
+void scope_decode_init(scope_decoder_t* d);
+
+// Returns false (and leaves d untouched) if the config can't work at this
+// sample rate, e.g. fewer than SCOPE_DECODE_MIN_SAMPLES_PER_BIT samples per bit.
+bool scope_decode_config(scope_decoder_t* d, const scope_decode_cfg_t* cfg, uint32_t sample_rate);
+
+// Just the checks scope_decode_config() does, without a decoder to apply them to
+bool scope_decode_check(const scope_decode_cfg_t* cfg, uint32_t sample_rate);
+
+static inline bool scope_decode_active(const scope_decoder_t* d) {
+    return d->cfg.proto != SCOPE_DECODE_OFF;
+}
+
+// Feeds one frame of ADC codes. Decoded characters pile up in d->events.
+void scope_decode_feed(scope_decoder_t* d, const uint16_t* samples, size_t n);
+
+// Encodes the pending events into out (see top of file) and clears them.
+// Returns the frame length, 0 if there's nothing to send.
+size_t scope_decode_take_events(scope_decoder_t* d, uint8_t* out, size_t out_len);
+
+// Drop pending events (nobody is listening)
+void scope_decode_clear_events(scope_decoder_t* d);
+
+#endif // SCOPE_DECODE_H
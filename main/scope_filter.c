@@ -0,0 +1,206 @@
+#include "scope_filter.h"
+
+#include <math.h>
+#include <string.h>
+
+#define COEF_SHIFT   30
+#define CODE_SHIFT   13   // 12-bit code (+-2048) -> Q24
+#define CODE_MID     2048
+#define CODE_MAX     4095
+
+// Block size for the int32 scratch buffer. 1KB of stack, and every stage runs
+// over the whole block before the next one so the inner loops stay tight.
+#define BLOCK        256
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+scope_filter_type_t scope_filter_type_from_name(const char* name) {
+    if (!name) return SCOPE_FILTER_NONE;
+    if (strcmp(name, "lowpass") == 0) return SCOPE_FILTER_LOWPASS;
+    if (strcmp(name, "highpass") == 0) return SCOPE_FILTER_HIGHPASS;
+    if (strcmp(name, "notch") == 0) return SCOPE_FILTER_NOTCH;
+    if (strcmp(name, "avg") == 0) return SCOPE_FILTER_MOVING_AVG;
+    return SCOPE_FILTER_NONE;
+}
+
+void scope_filter_chain_init(scope_filter_chain_t* chain) {
+    memset(chain, 0, sizeof(*chain));
+}
+
+static int32_t to_q30(double v) {
+    return (int32_t)lround(v * (double)(1 << COEF_SHIFT));
+}
+
+// RBJ audio EQ cookbook, designed in double once, then quantized
+static bool design_biquad(scope_filter_stage_t* st, const scope_filter_cfg_t* cfg, uint32_t fs) {
+    if (cfg->freq_hz <= 0 || cfg->freq_hz >= fs / 2.0) return false;
+
+    double q = cfg->q > 0 ? cfg->q : M_SQRT1_2;
+    double w0 = 2 * M_PI * cfg->freq_hz / fs;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2 * q);
+    double b0, b1, b2;
+
+    switch (cfg->type) {
+        case SCOPE_FILTER_LOWPASS:
+            b0 = (1 - cw) / 2; b1 = 1 - cw; b2 = (1 - cw) / 2;
+            break;
+        case SCOPE_FILTER_HIGHPASS:
+            b0 = (1 + cw) / 2; b1 = -(1 + cw); b2 = (1 + cw) / 2;
+            break;
+        case SCOPE_FILTER_NOTCH:
+            b0 = 1; b1 = -2 * cw; b2 = 1;
+            break;
+        default:
+            return false;
+    }
+    double a0 = 1 + alpha;
+
+    memset(st, 0, sizeof(*st));
+    st->type = cfg->type;
+    st->bq.b0 = to_q30(b0 / a0);
+    st->bq.b1 = to_q30(b1 / a0);
+    st->bq.b2 = to_q30(b2 / a0);
+    st->bq.a1 = to_q30(-2 * cw / a0);
+    st->bq.a2 = to_q30((1 - alpha) / a0);
+    return true;
+}
+
+static bool design_stage(scope_filter_stage_t* st, const scope_filter_cfg_t* cfg, uint32_t fs) {
+    if (cfg->type == SCOPE_FILTER_MOVING_AVG) {
+        if (cfg->taps < 1 || cfg->taps > SCOPE_FILTER_MAX_TAPS) return false;
+        memset(st, 0, sizeof(*st));
+        st->type = cfg->type;
+        st->ma.taps = cfg->taps;
+        st->ma.recip = (int32_t)((1 << COEF_SHIFT) / cfg->taps);
+        return true;
+    }
+    return design_biquad(st, cfg, fs);
+}
+
+bool scope_filter_chain_set(scope_filter_chain_t* chain, const scope_filter_cfg_t* cfg, size_t n,
+                            uint32_t sample_rate) {
+    if (n > SCOPE_FILTER_MAX_STAGES || sample_rate == 0) return false;
+
+    // Design into a scratch copy so a bad stage doesn't leave a half-built chain
+    scope_filter_stage_t stages[SCOPE_FILTER_MAX_STAGES];
+    for (size_t i = 0; i < n; i++) {
+        if (!design_stage(&stages[i], &cfg[i], sample_rate)) return false;
+    }
+
+    memcpy(chain->cfg, cfg, n * sizeof(*cfg));
+    memcpy(chain->stage, stages, n * sizeof(*stages));
+    chain->num_stages = (uint8_t)n;
+    chain->sample_rate = sample_rate;
+    return true;
+}
+
+bool scope_filter_chain_set_rate(scope_filter_chain_t* chain, uint32_t sample_rate) {
+    scope_filter_cfg_t cfg[SCOPE_FILTER_MAX_STAGES];
+    size_t n = chain->num_stages;
+    memcpy(cfg, chain->cfg, sizeof(cfg));
+
+    if (scope_filter_chain_set(chain, cfg, n, sample_rate)) return true;
+
+    // e.g. a 30kHz low-pass after dropping to 20kHz: better unfiltered than wrong
+    chain->num_stages = 0;
+    chain->sample_rate = sample_rate;
+    return false;
+}
+
+void scope_filter_chain_reset(scope_filter_chain_t* chain) {
+    for (int i = 0; i < chain->num_stages; i++) {
+        scope_filter_stage_t* st = &chain->stage[i];
+        if (st->type == SCOPE_FILTER_MOVING_AVG) {
+            st->ma.pos = 0;
+            st->ma.sum = 0;
+            memset(st->ma.ring, 0, sizeof(st->ma.ring));
+        } else {
+            st->bq.x1 = st->bq.x2 = st->bq.y1 = st->bq.y2 = 0;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// Kernels
+// -------------------------------------------------------------------------
+
+static void biquad_run(scope_filter_stage_t* st, int32_t* x, size_t n) {
+    // Locals so the compiler keeps everything in registers across the loop
+    const int32_t b0 = st->bq.b0, b1 = st->bq.b1, b2 = st->bq.b2;
+    const int32_t a1 = st->bq.a1, a2 = st->bq.a2;
+    int32_t x1 = st->bq.x1, x2 = st->bq.x2, y1 = st->bq.y1, y2 = st->bq.y2;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t in = x[i];
+        int64_t acc = (int64_t)1 << (COEF_SHIFT - 1); // round to nearest
+        acc += (int64_t)b0 * in;
+        acc += (int64_t)b1 * x1;
+        acc += (int64_t)b2 * x2;
+        acc -= (int64_t)a1 * y1;
+        acc -= (int64_t)a2 * y2;
+        int32_t out = (int32_t)(acc >> COEF_SHIFT);
+
+        x2 = x1;
+        x1 = in;
+        y2 = y1;
+        y1 = out;
+        x[i] = out;
+    }
+
+    st->bq.x1 = x1;
+    st->bq.x2 = x2;
+    st->bq.y1 = y1;
+    st->bq.y2 = y2;
+}
+
+static void moving_avg_run(scope_filter_stage_t* st, int32_t* x, size_t n) {
+    const uint16_t taps = st->ma.taps;
+    const int32_t recip = st->ma.recip;
+    int32_t* ring = st->ma.ring;
+    uint16_t pos = st->ma.pos;
+    int64_t sum = st->ma.sum;
+
+    // Running sum: one add + one subtract per sample no matter how many taps
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i] - ring[pos];
+        ring[pos] = x[i];
+        if (++pos == taps) pos = 0;
+        x[i] = (int32_t)((sum * recip) >> COEF_SHIFT);
+    }
+
+    st->ma.pos = pos;
+    st->ma.sum = sum;
+}
+
+void scope_filter_chain_process(scope_filter_chain_t* chain, uint16_t* samples, size_t n) {
+    int32_t buf[BLOCK];
+
+    while (n > 0) {
+        size_t len = n > BLOCK ? BLOCK : n;
+
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = ((int32_t)samples[i] - CODE_MID) * (1 << CODE_SHIFT);
+        }
+
+        for (int s = 0; s < chain->num_stages; s++) {
+            scope_filter_stage_t* st = &chain->stage[s];
+            if (st->type == SCOPE_FILTER_MOVING_AVG) {
+                moving_avg_run(st, buf, len);
+            } else {
+                biquad_run(st, buf, len);
+            }
+        }
+
+        for (size_t i = 0; i < len; i++) {
+            // Round back to a code and clamp: a high-pass or notch can overshoot the rails
+            int32_t v = ((buf[i] + (1 << (CODE_SHIFT - 1))) >> CODE_SHIFT) + CODE_MID;
+            samples[i] = (uint16_t)(v < 0 ? 0 : (v > CODE_MAX ? CODE_MAX : v));
+        }
+
+        samples += len;
+        n -= len;
+    }
+}
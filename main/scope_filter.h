@@ -0,0 +1,86 @@
+#ifndef SCOPE_FILTER_H
+#define SCOPE_FILTER_H
+
+// Fixed-point filter chain applied to each ADC frame before it's sent.
+// Plain C (no IDF headers) so it can be built and checked on a host too.
+//
+// Formats:
+//   data   int32 Q8.24, 12-bit codes are centered on 2048 and shifted up 13,
+//          so full scale is +-1.0 with 7 bits of headroom for overshoot
+//   coefs  int32 Q2.30 (biquad coefficients live in [-2, 2))
+//   accum  int64
+// Biquads are Direct Form I, which with a wide accumulator and Q24 state is
+// happy even with a 50Hz notch at 80kHz (poles very close to the unit circle).
+//
+// State is kept across calls, so feeding frame after frame is the same as
+// filtering one continuous signal.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCOPE_FILTER_MAX_STAGES 4
+#define SCOPE_FILTER_MAX_TAPS   64
+
+typedef enum {
+    SCOPE_FILTER_NONE = 0,
+    SCOPE_FILTER_LOWPASS,   // biquad, freq_hz = cutoff
+    SCOPE_FILTER_HIGHPASS,  // biquad, freq_hz = cutoff
+    SCOPE_FILTER_NOTCH,     // biquad, freq_hz = center (50/60 for mains)
+    SCOPE_FILTER_MOVING_AVG // FIR, taps samples
+} scope_filter_type_t;
+
+typedef struct {
+    scope_filter_type_t type;
+    float freq_hz;
+    float q;        // biquads only, 0 = 0.7071 (Butterworth)
+    uint16_t taps;  // moving average only
+} scope_filter_cfg_t;
+
+typedef struct {
+    scope_filter_type_t type;
+    union {
+        struct {
+            int32_t b0, b1, b2, a1, a2;
+            int32_t x1, x2, y1, y2;
+        } bq;
+        struct {
+            uint16_t taps;
+            uint16_t pos;
+            int32_t recip; // Q30 1/taps
+            int64_t sum;
+            int32_t ring[SCOPE_FILTER_MAX_TAPS];
+        } ma;
+    };
+} scope_filter_stage_t;
+
+typedef struct {
+    uint8_t num_stages;
+    uint32_t sample_rate;
+    scope_filter_cfg_t cfg[SCOPE_FILTER_MAX_STAGES];
+    scope_filter_stage_t stage[SCOPE_FILTER_MAX_STAGES];
+} scope_filter_chain_t;
+
+// "lowpass", "highpass", "notch", "avg"; SCOPE_FILTER_NONE if unknown
+scope_filter_type_t scope_filter_type_from_name(const char* name);
+
+void scope_filter_chain_init(scope_filter_chain_t* chain);
+
+// Designs the coefficients and clears the state. On a bad config (freq not
+// below Nyquist, too many stages/taps...) returns false and leaves chain as is.
+bool scope_filter_chain_set(scope_filter_chain_t* chain, const scope_filter_cfg_t* cfg, size_t n,
+                            uint32_t sample_rate);
+
+// Re-designs for a new sample rate, keeps the configured stages
+bool scope_filter_chain_set_rate(scope_filter_chain_t* chain, uint32_t sample_rate);
+
+void scope_filter_chain_reset(scope_filter_chain_t* chain);
+
+static inline bool scope_filter_chain_active(const scope_filter_chain_t* chain) {
+    return chain->num_stages > 0;
+}
+
+// Filters 12-bit ADC codes in place
+void scope_filter_chain_process(scope_filter_chain_t* chain, uint16_t* samples, size_t n);
+
+#endif // SCOPE_FILTER_H
@@ -0,0 +1,195 @@
+#include "scope_mask.h"
+
+#include <string.h>
+
+#include "scope_codec.h"
+
+void scope_mask_init(scope_mask_t* m) {
+    memset(m, 0, sizeof(*m));
+}
+
+void scope_mask_reset(scope_mask_t* m) {
+    m->in_wave = false;
+    m->fill = 0;
+    m->armed = false;
+    m->hist_n = 0;
+    m->num_captures = 0;
+    m->tested = 0;
+    m->passed = 0;
+    m->failed = 0;
+}
+
+bool scope_mask_config(scope_mask_t* m, const scope_mask_cfg_t* cfg) {
+    if (cfg->mode == SCOPE_MASK_OFF) {
+        scope_mask_init(m);
+        return true;
+    }
+    if (cfg->mode != SCOPE_MASK_TEST && cfg->mode != SCOPE_MASK_TEACH) return false;
+    if (cfg->len == 0 || cfg->len > SCOPE_MASK_MAX_LEN) return false;
+    if (cfg->trigger != SCOPE_MASK_TRIG_NONE && cfg->pre >= cfg->len) return false;
+    if (cfg->mode == SCOPE_MASK_TEST) {
+        for (int i = 0; i < cfg->len; i++) {
+            if (cfg->lo[i] > cfg->hi[i]) return false;
+        }
+    }
+
+    uint32_t idx = m->idx; // keep the sample count running, it's what capture t is in
+    scope_mask_init(m);
+    m->idx = idx;
+    m->mode = cfg->mode;
+    m->trigger = cfg->trigger;
+    m->level = cfg->level;
+    m->hyst = cfg->hyst ? cfg->hyst : 1; // 0 would let one sample arm and fire
+    m->len = cfg->len;
+    m->pre = (cfg->trigger == SCOPE_MASK_TRIG_NONE) ? 0 : cfg->pre;
+    m->tol = cfg->tol;
+
+    if (cfg->mode == SCOPE_MASK_TEST) {
+        for (int i = 0; i < cfg->len; i++) {
+            m->lo[i] = cfg->lo[i];
+            m->span[i] = cfg->hi[i] - cfg->lo[i];
+        }
+    }
+    return true;
+}
+
+uint32_t scope_mask_compare(const uint16_t* x, const uint16_t* lo, const uint16_t* span, size_t n) {
+    uint32_t viol = 0;
+    // x - lo wraps to something huge when x < lo, so a single unsigned compare
+    // catches both sides. No data-dependent branches, the compiler keeps it a
+    // straight load/sub/compare/add loop.
+    for (size_t i = 0; i < n; i++) {
+        viol += (uint16_t)(x[i] - lo[i]) > span[i];
+    }
+    return viol;
+}
+
+// Slow path, only runs on a failed waveform
+static uint16_t first_fail(const scope_mask_t* m) {
+    for (uint16_t i = 0; i < m->len; i++) {
+        if ((uint16_t)(m->wave[i] - m->lo[i]) > m->span[i]) return i;
+    }
+    return 0;
+}
+
+// Keep the last pre samples seen while looking for a trigger
+static void push_hist(scope_mask_t* m, const uint16_t* s, size_t k) {
+    const uint16_t pre = m->pre;
+    if (pre == 0 || k == 0) return;
+
+    if (k >= pre) {
+        memcpy(m->hist, s + k - pre, pre * sizeof(uint16_t));
+        m->hist_n = pre;
+    } else {
+        size_t keep = (m->hist_n < pre - k) ? m->hist_n : pre - k;
+        memmove(m->hist, m->hist + m->hist_n - keep, keep * sizeof(uint16_t));
+        memcpy(m->hist + keep, s, k * sizeof(uint16_t));
+        m->hist_n = (uint16_t)(keep + k);
+    }
+}
+
+// Index of the first trigger sample in s[from, n), or n. Updates armed.
+static size_t find_trigger(scope_mask_t* m, const uint16_t* s, size_t from, size_t n) {
+    const int level = m->level, hyst = m->hyst;
+    bool armed = m->armed;
+    size_t i = from;
+
+    if (m->trigger == SCOPE_MASK_TRIG_RISING) {
+        for (; i < n; i++) {
+            if (armed && s[i] >= level) break;
+            if (s[i] <= level - hyst) armed = true;
+        }
+    } else {
+        for (; i < n; i++) {
+            if (armed && s[i] <= level) break;
+            if (s[i] >= level + hyst) armed = true;
+        }
+    }
+    m->armed = (i < n) ? false : armed;
+    return i;
+}
+
+static void finish_wave(scope_mask_t* m) {
+    m->in_wave = false;
+
+    if (m->mode == SCOPE_MASK_TEACH) {
+        for (int i = 0; i < m->len; i++) {
+            int lo = m->wave[i] - m->tol;
+            int hi = m->wave[i] + m->tol;
+            if (lo < 0) lo = 0;
+            if (hi > SCOPE_CODEC_MAX_CODE) hi = SCOPE_CODEC_MAX_CODE;
+            m->lo[i] = (uint16_t)lo;
+            m->span[i] = (uint16_t)(hi - lo);
+        }
+        m->mode = SCOPE_MASK_TEST;
+    } else {
+        uint32_t viol = scope_mask_compare(m->wave, m->lo, m->span, m->len);
+        m->tested++;
+        if (viol == 0) {
+            m->passed++;
+        } else {
+            m->failed++;
+            if (m->num_captures < SCOPE_MASK_MAX_CAPTURES) {
+                scope_mask_capture_t* c = &m->captures[m->num_captures];
+                c->t = m->t_wave;
+                c->first_fail = first_fail(m);
+                c->violations = (uint16_t)viol;
+                memcpy(c->samples, m->wave, m->len * sizeof(uint16_t));
+                m->num_captures++;
+            }
+        }
+    }
+
+    // The tail of this waveform is the pre-trigger history for the next one
+    if (m->pre) {
+        memcpy(m->hist, m->wave + m->len - m->pre, m->pre * sizeof(uint16_t));
+        m->hist_n = m->pre;
+    }
+    m->armed = false;
+}
+
+void scope_mask_feed(scope_mask_t* m, const uint16_t* samples, size_t n) {
+    if (m->mode == SCOPE_MASK_OFF) return;
+
+    size_t pos = 0;
+    while (pos < n) {
+        if (m->in_wave) {
+            size_t take = m->len - m->fill;
+            if (take > n - pos) take = n - pos;
+            memcpy(m->wave + m->fill, samples + pos, take * sizeof(uint16_t));
+            m->fill += (uint16_t)take;
+            pos += take;
+            if (m->fill == m->len) finish_wave(m);
+        } else if (m->trigger == SCOPE_MASK_TRIG_NONE) {
+            m->in_wave = true;
+            m->fill = 0;
+            m->t_wave = m->idx + (uint32_t)pos;
+        } else {
+            size_t hit = find_trigger(m, samples, pos, n);
+            size_t before = hit - pos; // samples of this frame ahead of the trigger
+
+            if (hit == n) {
+                push_hist(m, samples + pos, before);
+                pos = n;
+            } else if (m->hist_n + before < m->pre) {
+                // Not enough history yet for the pre-trigger part, skip this one
+                push_hist(m, samples + pos, before + 1);
+                pos = hit + 1;
+            } else {
+                const uint16_t pre = m->pre;
+                if (before >= pre) {
+                    memcpy(m->wave, samples + hit - pre, pre * sizeof(uint16_t));
+                } else {
+                    size_t from_hist = pre - before;
+                    memcpy(m->wave, m->hist + m->hist_n - from_hist, from_hist * sizeof(uint16_t));
+                    memcpy(m->wave + from_hist, samples + pos, before * sizeof(uint16_t));
+                }
+                m->in_wave = true;
+                m->fill = pre;
+                m->t_wave = m->idx + (uint32_t)hit - pre;
+                pos = hit;
+            }
+        }
+    }
+    m->idx += (uint32_t)n;
+}
@@ -0,0 +1,102 @@
+#ifndef SCOPE_MASK_H
+#define SCOPE_MASK_H
+
+// Mask (limit) testing: every acquired sample is checked against a lower/upper
+// envelope, whether or not the frame ever gets sent. Plain C (no IDF headers)
+// like the other scope_* modules.
+//
+// A "waveform" is len samples:
+//   - triggered: starting pre samples before a level crossing, so lo[i]/hi[i]
+//     are limits at a fixed offset from the trigger
+//   - free running (no trigger): back-to-back windows of len samples, which with
+//     a flat lo/hi is a plain voltage limit test on the whole stream
+// Each waveform passes or fails as a whole. The first SCOPE_MASK_MAX_CAPTURES
+// failing ones are kept for download.
+//
+// Teach mode grabs the next waveform and turns it into the mask (+-tol), then
+// switches to testing.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCOPE_MASK_MAX_LEN      1024
+#define SCOPE_MASK_MAX_CAPTURES 4
+
+typedef enum {
+    SCOPE_MASK_OFF = 0,
+    SCOPE_MASK_TEST,
+    SCOPE_MASK_TEACH,
+} scope_mask_mode_t;
+
+typedef enum {
+    SCOPE_MASK_TRIG_NONE = 0, // free running
+    SCOPE_MASK_TRIG_RISING,
+    SCOPE_MASK_TRIG_FALLING,
+} scope_mask_trig_t;
+
+typedef struct {
+    scope_mask_mode_t mode;
+    scope_mask_trig_t trigger;
+    uint16_t level;   // trigger level, ADC codes
+    uint16_t hyst;    // has to go this far past level the other way to re-arm
+    uint16_t len;     // samples per waveform, 1..SCOPE_MASK_MAX_LEN
+    uint16_t pre;     // of which before the trigger (< len, 0 if free running)
+    uint16_t tol;     // teach only: envelope = taught waveform +- tol
+    uint16_t lo[SCOPE_MASK_MAX_LEN]; // test only, per offset, inclusive
+    uint16_t hi[SCOPE_MASK_MAX_LEN];
+} scope_mask_cfg_t;
+
+typedef struct {
+    uint32_t t;           // sample index of wave[0]
+    uint16_t first_fail;  // offset of the first sample outside the mask
+    uint16_t violations;  // samples outside the mask
+    uint16_t samples[SCOPE_MASK_MAX_LEN];
+} scope_mask_capture_t;
+
+typedef struct {
+    scope_mask_mode_t mode;
+    scope_mask_trig_t trigger;
+    uint16_t level, hyst, len, pre, tol;
+    // Kept as lo + (hi - lo) so the kernel needs one unsigned compare per sample
+    uint16_t lo[SCOPE_MASK_MAX_LEN];
+    uint16_t span[SCOPE_MASK_MAX_LEN];
+
+    // Running across frames
+    uint32_t idx;         // sample index of the next input sample
+    bool armed;
+    bool in_wave;
+    uint16_t fill;
+    uint32_t t_wave;
+    uint16_t wave[SCOPE_MASK_MAX_LEN];
+    uint16_t hist[SCOPE_MASK_MAX_LEN]; // last pre samples while looking for a trigger
+    uint16_t hist_n;
+
+    // Results. Only the ADC task writes these, the web server just reads them.
+    volatile uint32_t tested;
+    volatile uint32_t passed;
+    volatile uint32_t failed;
+    volatile uint8_t num_captures; // bumped after the capture is complete
+    scope_mask_capture_t captures[SCOPE_MASK_MAX_CAPTURES];
+} scope_mask_t;
+
+void scope_mask_init(scope_mask_t* m);
+
+// Returns false (and leaves m untouched) on a bad config: len out of range,
+// pre >= len, or lo > hi anywhere. Resets the counters and captures.
+bool scope_mask_config(scope_mask_t* m, const scope_mask_cfg_t* cfg);
+
+// Zero the counters/captures and drop any half-acquired waveform, keep the mask
+void scope_mask_reset(scope_mask_t* m);
+
+static inline bool scope_mask_active(const scope_mask_t* m) {
+    return m->mode != SCOPE_MASK_OFF;
+}
+
+// Feeds one frame of ADC codes
+void scope_mask_feed(scope_mask_t* m, const uint16_t* samples, size_t n);
+
+// The comparison kernel: number of x[i] outside [lo[i], lo[i] + span[i]]
+uint32_t scope_mask_compare(const uint16_t* x, const uint16_t* lo, const uint16_t* span, size_t n);
+
+#endif // SCOPE_MASK_H
@@ -0,0 +1,88 @@
+#include "scope_settings.h"
+
+#include <string.h>
+#include "nvs.h"
+
+#define NVS_NAMESPACE   "scope_cfg"
+#define NVS_KEY_SCOPE   "scope"
+#define SETTINGS_VER    1
+
+// Stored as one blob so a load/save is a single NVS lookup
+typedef struct {
+    uint8_t  version;
+    uint8_t  atten;
+    uint16_t test_hz;
+    uint32_t sample_rate;
+} stored_settings_t;
+
+esp_err_t scope_settings_load(scope_settings_t* s) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+
+    stored_settings_t st;
+    size_t len = sizeof(st);
+    err = nvs_get_blob(h, NVS_KEY_SCOPE, &st, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK) return err;
+    if (len != sizeof(st) || st.version != SETTINGS_VER) return ESP_ERR_INVALID_VERSION;
+
+    s->sample_rate = st.sample_rate;
+    s->atten = st.atten;
+    s->test_hz = st.test_hz;
+    return ESP_OK;
+}
+
+esp_err_t scope_settings_save(const scope_settings_t* s) {
+    stored_settings_t st = {
+        .version = SETTINGS_VER,
+        .atten = s->atten,
+        .test_hz = s->test_hz,
+        .sample_rate = s->sample_rate,
+    };
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    // The page re-sends its config on every (re)connect, don't wear the flash for that
+    stored_settings_t old;
+    size_t len = sizeof(old);
+    if (nvs_get_blob(h, NVS_KEY_SCOPE, &old, &len) == ESP_OK && len == sizeof(old) &&
+        memcmp(&old, &st, sizeof(st)) == 0) {
+        nvs_close(h);
+        return ESP_OK;
+    }
+
+    err = nvs_set_blob(h, NVS_KEY_SCOPE, &st, sizeof(st));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+void scope_settings_clamp(scope_settings_t* s) {
+    if (s->sample_rate < SCOPE_MIN_SAMPLE_RATE) s->sample_rate = SCOPE_MIN_SAMPLE_RATE;
+    if (s->sample_rate > SCOPE_MAX_SAMPLE_RATE) s->sample_rate = SCOPE_MAX_SAMPLE_RATE;
+    if (s->atten > SCOPE_MAX_ATTEN) s->atten = SCOPE_MAX_ATTEN;
+}
+
+bool scope_settings_restore(scope_settings_t* s) {
+    scope_settings_t saved = *s;
+    if (scope_settings_load(&saved) != ESP_OK) return false;
+
+    // Clamp before it gets anywhere near the ADC, see scope_settings.h
+    scope_settings_clamp(&saved);
+    if (saved.test_hz == 0) saved.test_hz = s->test_hz;
+    *s = saved;
+    return true;
+}
+
+void scope_settings_erase(void) {
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK) {
+        nvs_erase_all(h);
+        nvs_commit(h);
+        nvs_close(h);
+    }
+}
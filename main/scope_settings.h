@@ -0,0 +1,40 @@
+#ifndef SCOPE_SETTINGS_H
+#define SCOPE_SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Last scope settings, persisted so a reboot comes back sampling the same way
+// without waiting for the browser to push them again.
+// Only talks to nvs.h, nothing else from IDF.
+
+// What adc_continuous_config takes on the classic ESP32. Anything outside this
+// makes it fail, and main.c ESP_ERROR_CHECKs it, so a bad stored value would
+// abort every boot before the BOOT button reset even gets a chance.
+#define SCOPE_MIN_SAMPLE_RATE   20000
+#define SCOPE_MAX_SAMPLE_RATE   83333
+#define SCOPE_MAX_ATTEN         3 // ADC_ATTEN_DB_12
+
+typedef struct {
+    uint32_t sample_rate;
+    uint8_t  atten;
+    uint16_t test_hz;
+} scope_settings_t;
+
+// Leaves *s untouched (i.e. the caller's defaults) if nothing is stored yet
+esp_err_t scope_settings_load(scope_settings_t* s);
+
+// No-op if the stored copy already matches, so it's fine to call on every /params
+esp_err_t scope_settings_save(const scope_settings_t* s);
+
+void scope_settings_erase(void);
+
+// Clamps sample_rate/atten into the ranges above
+void scope_settings_clamp(scope_settings_t* s);
+
+// Load + clamp on top of the defaults in *s (a stored test_hz of 0 keeps the
+// default). Returns true if stored settings were applied.
+bool scope_settings_restore(scope_settings_t* s);
+
+#endif // SCOPE_SETTINGS_H
@@ -0,0 +1,208 @@
+#include "scope_udp.h"
+
+#include <string.h>
+
+#include "scope_codec.h"
+
+// Byte-wise so it doesn't matter what endianness/alignment the host has
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void scope_udp_write_hdr(uint8_t* buf, const scope_udp_hdr_t* hdr) {
+    put16(buf + 0, SCOPE_UDP_MAGIC);
+    buf[2] = SCOPE_UDP_VERSION;
+    buf[3] = hdr->flags;
+    put32(buf + 4, hdr->seq);
+    put32(buf + 8, hdr->first_sample);
+    put32(buf + 12, hdr->t_us);
+    put32(buf + 16, hdr->sample_rate);
+    put16(buf + 20, hdr->count);
+    put16(buf + 22, hdr->tx_drops);
+    put32(buf + 24, hdr->session);
+}
+
+bool scope_udp_read_hdr(const uint8_t* buf, size_t len, scope_udp_hdr_t* hdr) {
+    if (len < SCOPE_UDP_HDR_LEN) return false;
+    if (get16(buf) != SCOPE_UDP_MAGIC || buf[2] != SCOPE_UDP_VERSION) return false;
+
+    hdr->flags = buf[3];
+    hdr->seq = get32(buf + 4);
+    hdr->first_sample = get32(buf + 8);
+    hdr->t_us = get32(buf + 12);
+    hdr->sample_rate = get32(buf + 16);
+    hdr->count = get16(buf + 20);
+    hdr->tx_drops = get16(buf + 22);
+    hdr->session = get32(buf + 24);
+
+    return len == SCOPE_UDP_HDR_LEN + scope_codec_len(hdr->count);
+}
+
+// -------------------------------------------------------------------------
+// Sender
+// -------------------------------------------------------------------------
+
+void scope_udp_tx_init(scope_udp_tx_t* tx, uint32_t sample_rate, uint16_t max_samples, uint32_t session) {
+    memset(tx, 0, sizeof(*tx));
+    if (max_samples == 0 || max_samples > SCOPE_UDP_MAX_SAMPLES) max_samples = SCOPE_UDP_MAX_SAMPLES;
+    tx->max_samples = max_samples;
+    tx->sample_rate = sample_rate;
+    tx->session = session;
+    tx->pending_flags = SCOPE_UDP_FLAG_RECONFIG;
+}
+
+void scope_udp_tx_reconfig(scope_udp_tx_t* tx, uint32_t sample_rate) {
+    tx->sample_rate = sample_rate;
+    tx->pending_flags |= SCOPE_UDP_FLAG_RECONFIG;
+}
+
+int scope_udp_tx_frame(scope_udp_tx_t* tx, const uint16_t* samples, size_t n, uint32_t t_us,
+                       scope_udp_send_fn send, void* ctx) {
+    // Static: 1.5KB is too much for the ADC task stack
+    static uint8_t dgram[SCOPE_UDP_MAX_DGRAM];
+    int dropped = 0;
+
+    while (n > 0) {
+        uint16_t count = (n > tx->max_samples) ? tx->max_samples : (uint16_t)n;
+
+        scope_udp_hdr_t hdr = {
+            .flags = tx->pending_flags,
+            .seq = tx->seq++,
+            .first_sample = tx->sample_index,
+            .t_us = t_us,
+            .sample_rate = tx->sample_rate,
+            .count = count,
+            .tx_drops = tx->drops,
+            .session = tx->session,
+        };
+        scope_udp_write_hdr(dgram, &hdr);
+
+        scope_codec_encode(dgram + SCOPE_UDP_HDR_LEN, samples, count);
+
+        if (send(dgram, SCOPE_UDP_HDR_LEN + scope_codec_len(count), ctx) == 0) {
+            tx->pending_flags = 0;
+        } else {
+            // Keep the seq gap: the receiver sees it as loss, and tx_drops tells it
+            // the loss happened on our side and not over the air.
+            tx->drops++;
+            dropped++;
+        }
+
+        tx->sample_index += count;
+        samples += count;
+        n -= count;
+    }
+    return dropped;
+}
+
+// -------------------------------------------------------------------------
+// Receiver
+// -------------------------------------------------------------------------
+
+void scope_udp_rx_init(scope_udp_rx_t* rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+bool scope_udp_rx_is_stale(const scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr) {
+    return rx->started && rx->has_prev && hdr->session == rx->prev_session && hdr->session != rx->session;
+}
+
+bool scope_udp_rx_is_restart(const scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr) {
+    // A reordered datagram from before the reboot isn't the device going back
+    if (scope_udp_rx_is_stale(rx, hdr)) return false;
+    // Not just seq == 0: that one can be lost like any other, and if the device
+    // dropped it the RECONFIG flag rides on a later seq
+    return !rx->started || hdr->session != rx->session || (hdr->flags & SCOPE_UDP_FLAG_RECONFIG) ||
+           (int32_t)(hdr->seq - rx->next_seq) < -SCOPE_UDP_MAX_REORDER;
+}
+
+uint32_t scope_udp_rx_account(scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr, size_t len,
+                              int64_t arrival_us) {
+    uint32_t gap = 0;
+
+    if (scope_udp_rx_is_stale(rx, hdr)) {
+        rx->stale++;
+        return 0;
+    }
+
+    if (scope_udp_rx_is_restart(rx, hdr)) {
+        int32_t d = (int32_t)(hdr->seq - rx->next_seq);
+        if (!rx->started) {
+            // Joined mid-stream, whatever came before isn't ours to count
+        } else if (hdr->session != rx->session) {
+            // Rebooted: seq and tx_drops start over at 0, so everything before this
+            // datagram in the new session is known loss
+            gap = hdr->seq;
+            rx->lost += gap;
+            rx->tx_drops += hdr->tx_drops;
+            rx->has_prev = true;
+            rx->prev_session = rx->session;
+        } else if (d >= 0) {
+            // Reconfig, same session: seq and tx_drops keep running
+            gap = (uint32_t)d;
+            rx->lost += gap;
+            rx->tx_drops += (uint16_t)(hdr->tx_drops - rx->last_tx_drops);
+        }
+        if (rx->started) rx->resyncs++;
+        rx->started = true;
+        rx->session = hdr->session;
+        rx->next_seq = hdr->seq + 1;
+        rx->seen = 1;
+        rx->last_transit_us = arrival_us - hdr->t_us;
+        rx->jitter_us = 0;
+        rx->last_tx_drops = hdr->tx_drops;
+    } else {
+        int32_t d = (int32_t)(hdr->seq - rx->next_seq);
+        if (d >= 0) {
+            gap = (uint32_t)d;
+            rx->lost += gap;
+            rx->seen = (gap >= 63) ? 0 : rx->seen << (gap + 1);
+            rx->seen |= 1;
+            rx->next_seq = hdr->seq + 1;
+            // Only in-order ones: a late datagram carries an older total
+            rx->tx_drops += (uint16_t)(hdr->tx_drops - rx->last_tx_drops);
+            rx->last_tx_drops = hdr->tx_drops;
+        } else {
+            uint32_t back = (uint32_t)(-d) - 1; // 0 = the one right before next_seq
+            if (back < 64 && (rx->seen & (1ULL << back))) {
+                rx->duplicates++;
+                return 0;
+            }
+            // Counted as lost when we skipped over it, take that back
+            if (back < 64) rx->seen |= 1ULL << back;
+            rx->late++;
+            if (rx->lost) rx->lost--;
+        }
+
+        // Device clock is 32-bit us, the wrap every ~71 min just shows up as one
+        // jitter outlier, so we clamp it away rather than tracking epochs.
+        int64_t transit = arrival_us - hdr->t_us;
+        int64_t delta = transit - rx->last_transit_us;
+        if (delta < 0) delta = -delta;
+        if (delta < 1000000) {
+            rx->jitter_us += ((double)delta - rx->jitter_us) / 16.0;
+        }
+        rx->last_transit_us = transit;
+    }
+
+    rx->received++;
+    rx->samples += hdr->count;
+    rx->bytes += len;
+    return gap;
+}
@@ -0,0 +1,129 @@
+#ifndef SCOPE_UDP_H
+#define SCOPE_UDP_H
+
+// UDP datagram framing for the sample stream.
+// Plain C on purpose (no IDF headers) so the Linux tools in ../tools build the
+// exact same encoder/decoder the firmware uses.
+//
+// Datagram layout, everything little-endian:
+//   0  u16  magic         'S','C'
+//   2  u8   version
+//   3  u8   flags         SCOPE_UDP_FLAG_*
+//   4  u32  seq           datagram counter, +1 per datagram
+//   8  u32  first_sample  running index of payload[0] (wraps)
+//  12  u32  t_us          device time of the ADC frame (low 32 bits of esp_timer)
+//  16  u32  sample_rate   Hz
+//  20  u16  count         number of samples in payload
+//  22  u16  tx_drops      datagrams the sender dropped so far this session (wraps). A running
+//                         total, so a datagram lost in the air doesn't lose the count.
+//  24  u32  session       random per boot, a new value means the device restarted
+//  28  u16  payload[count]   (scope_codec.h)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCOPE_UDP_MAGIC         0x4353 // "SC"
+#define SCOPE_UDP_VERSION       2
+#define SCOPE_UDP_HDR_LEN       28
+
+// 1500 MTU - 20 IP - 8 UDP. Anything bigger gets IP-fragmented and one lost
+// fragment kills the whole datagram, which is exactly what we're avoiding.
+#define SCOPE_UDP_MAX_DGRAM     1472
+#define SCOPE_UDP_MAX_SAMPLES   ((SCOPE_UDP_MAX_DGRAM - SCOPE_UDP_HDR_LEN) / 2)
+
+#define SCOPE_UDP_DEFAULT_PORT  5005
+
+// A seq further behind than this isn't reordering any more, the sender restarted
+#define SCOPE_UDP_MAX_REORDER   64
+
+// flags
+#define SCOPE_UDP_FLAG_RECONFIG 0x01 // first datagram after a rate/atten change
+
+typedef struct {
+    uint8_t  flags;
+    uint32_t seq;
+    uint32_t first_sample;
+    uint32_t t_us;
+    uint32_t sample_rate;
+    uint16_t count;
+    uint16_t tx_drops;
+    uint32_t session;
+} scope_udp_hdr_t;
+
+// Writes the 28-byte header into buf. buf must hold SCOPE_UDP_HDR_LEN bytes.
+void scope_udp_write_hdr(uint8_t* buf, const scope_udp_hdr_t* hdr);
+
+// Parses and sanity checks a received datagram.
+// Returns false on bad magic/version or if count doesn't match len.
+bool scope_udp_read_hdr(const uint8_t* buf, size_t len, scope_udp_hdr_t* hdr);
+
+// Sender side: splits each ADC frame into MTU-sized datagrams.
+typedef struct {
+    uint32_t seq;
+    uint32_t sample_index;
+    uint32_t sample_rate;
+    uint32_t session;
+    uint16_t max_samples;   // per datagram, clamped to SCOPE_UDP_MAX_SAMPLES
+    uint16_t drops;         // running total, goes out in every header
+    uint8_t  pending_flags;
+} scope_udp_tx_t;
+
+// Returns 0 if the datagram went out, anything else counts as a drop.
+typedef int (*scope_udp_send_fn)(const uint8_t* dgram, size_t len, void* ctx);
+
+// session should be different on every boot (e.g. esp_random())
+void scope_udp_tx_init(scope_udp_tx_t* tx, uint32_t sample_rate, uint16_t max_samples, uint32_t session);
+
+// Call after a reconfig so the receiver can reset its stats.
+void scope_udp_tx_reconfig(scope_udp_tx_t* tx, uint32_t sample_rate);
+
+// Packs samples into datagrams and hands each one to send().
+// Returns the number of datagrams dropped by send().
+int scope_udp_tx_frame(scope_udp_tx_t* tx, const uint16_t* samples, size_t n, uint32_t t_us,
+                       scope_udp_send_fn send, void* ctx);
+
+// Receiver side: loss / reorder / jitter accounting.
+typedef struct {
+    bool     started;
+    uint32_t session;
+    bool     has_prev;      // prev_session is valid
+    uint32_t prev_session;  // the one before the last reboot, its stragglers get ignored
+    uint32_t next_seq;      // next in-order seq we expect
+    uint64_t seen;          // bit i set = (next_seq - 1 - i) arrived
+    uint64_t received;
+    uint64_t lost;          // gaps in seq not (yet) filled by late arrivals, incl. tx_drops
+    uint64_t late;          // arrived after we'd already counted them lost
+    uint64_t duplicates;
+    uint64_t stale;         // from the previous session, arrived after the new one
+    uint64_t tx_drops;      // of those, dropped on the sender (lost - tx_drops = network loss)
+    uint16_t last_tx_drops; // header value of the last in-order datagram
+    uint64_t resyncs;       // sender restarts/reconfigs after the first datagram
+    uint64_t samples;
+    uint64_t bytes;
+    // RFC 3550 style interarrival jitter, in microseconds
+    double   jitter_us;
+    int64_t  last_transit_us;
+} scope_udp_rx_t;
+
+void scope_udp_rx_init(scope_udp_rx_t* rx);
+
+// Returns true if hdr starts over rather than continuing the stream rx has
+// seen so far: new session, reconfig, or seq jumped back past the reorder window.
+bool scope_udp_rx_is_restart(const scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr);
+
+// Returns true if hdr is a straggler from the session before the last reboot.
+// scope_udp_rx_account() just counts those in rx->stale, don't use the payload.
+bool scope_udp_rx_is_stale(const scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr);
+
+// Accounts one datagram. arrival_us is the receiver's clock.
+// Returns the number of datagrams lost right before this one (0 if in order).
+//
+// Loss across a restart: datagrams of the new session before the first one we
+// get are counted (seq and tx_drops start at 0). The tail of the old session
+// can't be: datagrams lost or dropped after the last one we got from it, and
+// drops whose updated total never arrived, are simply not known to the receiver.
+uint32_t scope_udp_rx_account(scope_udp_rx_t* rx, const scope_udp_hdr_t* hdr, size_t len,
+                              int64_t arrival_us);
+
+#endif // SCOPE_UDP_H
@@ -0,0 +1,58 @@
+#include "scope_wifi_cache.h"
+
+#include <string.h>
+#include "nvs.h"
+
+// Same namespace as the credentials in wifi_manager.c, so an erase_all there clears it too
+#define NVS_NAMESPACE   "wifi_cfg"
+#define NVS_KEY_FAST    "fast"
+
+bool scope_wifi_cache_load(scope_wifi_cache_t* c) {
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+
+    scope_wifi_cache_t st;
+    size_t len = sizeof(st);
+    esp_err_t err = nvs_get_blob(h, NVS_KEY_FAST, &st, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK || len != sizeof(st) || st.version != SCOPE_WIFI_CACHE_VER) return false;
+    if (st.channel < 1 || st.channel > 14) return false;
+
+    // Static IP 0.0.0.0 or a /0 would just never come up
+    if (st.has_ip && (st.ip == 0 || st.netmask == 0)) st.has_ip = 0;
+    *c = st;
+    return true;
+}
+
+esp_err_t scope_wifi_cache_save(const scope_wifi_cache_t* c) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    // Same AP, same lease is the usual case on a reconnect
+    scope_wifi_cache_t old;
+    size_t len = sizeof(old);
+    if (nvs_get_blob(h, NVS_KEY_FAST, &old, &len) == ESP_OK && len == sizeof(old) &&
+        memcmp(&old, c, sizeof(old)) == 0) {
+        nvs_close(h);
+        return ESP_OK;
+    }
+
+    err = nvs_set_blob(h, NVS_KEY_FAST, c, sizeof(*c));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t scope_wifi_cache_erase(void) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    err = nvs_erase_key(h, NVS_KEY_FAST);
+    if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
@@ -0,0 +1,39 @@
+#ifndef SCOPE_WIFI_CACHE_H
+#define SCOPE_WIFI_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Fast start cache: the AP (BSSID + channel) and lease of the last successful
+// connection, so the next boot can skip the all-channel scan (and DHCP).
+// Stored next to the WiFi credentials. Only talks to nvs.h, nothing else from IDF.
+
+#define SCOPE_WIFI_CACHE_VER 1
+
+// Addresses in lwip order (esp_ip4_addr_t.addr), 0 = not known
+typedef struct {
+    uint8_t  version;   // 0 = empty
+    uint8_t  channel;
+    uint8_t  bssid[6];
+    uint8_t  has_ip;
+    uint8_t  reserved[3];
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} scope_wifi_cache_t;
+
+// False if there's nothing usable stored: missing, wrong size/version, or a
+// channel outside 1..14. A lease without an address or netmask is dropped
+// (has_ip cleared), the AP part is still good.
+bool scope_wifi_cache_load(scope_wifi_cache_t* c);
+
+// No-op if the stored copy already matches, so it's fine to call on every GOT_IP
+esp_err_t scope_wifi_cache_save(const scope_wifi_cache_t* c);
+
+// Forget it, e.g. because the AP didn't answer or the credentials changed.
+// Nothing stored counts as success.
+esp_err_t scope_wifi_cache_erase(void);
+
+#endif // SCOPE_WIFI_CACHE_H
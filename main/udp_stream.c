@@ -0,0 +1,132 @@
+#include "udp_stream.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "lwip/sockets.h"
+#include "scope_udp.h"
+
+static const char* TAG = "UDP_STREAM";
+
+#ifndef CONFIG_SCOPE_UDP_HOST
+#define CONFIG_SCOPE_UDP_HOST "192.168.4.2"
+#endif
+#ifndef CONFIG_SCOPE_UDP_PORT
+#define CONFIG_SCOPE_UDP_PORT SCOPE_UDP_DEFAULT_PORT
+#endif
+#ifndef CONFIG_SCOPE_UDP_SAMPLES_PER_DGRAM
+#define CONFIG_SCOPE_UDP_SAMPLES_PER_DGRAM SCOPE_UDP_MAX_SAMPLES
+#endif
+
+// Written by httpd, copied by the ADC task before the flag is cleared. Same
+// handoff as the filter/mask config: httpd leaves these alone while it's set.
+static struct sockaddr_in s_target_pending;
+static bool s_enabled_pending = false;
+static volatile bool need_target_update = false;
+
+// ADC task only. s_target is read for every datagram of a frame.
+static struct sockaddr_in s_target;
+static bool s_enabled = false;
+static int s_sock = -1;
+static scope_udp_tx_t s_tx;
+static uint32_t s_drops_logged = 0;
+static uint32_t s_drops = 0;
+
+static int send_dgram(const uint8_t* dgram, size_t len, void* ctx) {
+    int sent = sendto(s_sock, dgram, len, 0, (struct sockaddr*)&s_target, sizeof(s_target));
+    // ENOMEM/EAGAIN just means lwip is out of pbufs. Drop it, don't wait.
+    return (sent == (int)len) ? 0 : -1;
+}
+
+static bool open_socket(void) {
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return false;
+    }
+
+    // Non-blocking: a stalled WiFi link must never hold up the ADC reads
+    int flags = fcntl(s_sock, F_GETFL, 0);
+    fcntl(s_sock, F_SETFL, flags | O_NONBLOCK);
+
+    ESP_LOGI(TAG, "Streaming to %s:%d", inet_ntoa(s_target.sin_addr), ntohs(s_target.sin_port));
+    return true;
+}
+
+void udp_stream_init(uint32_t sample_rate) {
+    // New session id every boot so the receiver can tell a restart from reordering
+    scope_udp_tx_init(&s_tx, sample_rate, CONFIG_SCOPE_UDP_SAMPLES_PER_DGRAM, esp_random());
+#ifdef CONFIG_SCOPE_UDP_STREAM
+    udp_stream_set_target(CONFIG_SCOPE_UDP_HOST, CONFIG_SCOPE_UDP_PORT);
+#endif
+}
+
+void udp_stream_set_target(const char* host, uint16_t port) {
+    if (need_target_update) {
+        ESP_LOGW(TAG, "Previous UDP target not picked up yet, ignoring");
+        return;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (port != 0 && (!host || inet_pton(AF_INET, host, &addr.sin_addr) != 1)) {
+        ESP_LOGE(TAG, "Bad UDP target '%s'", host ? host : "");
+        return;
+    }
+    if (port == 0) ESP_LOGI(TAG, "UDP stream off");
+
+    s_target_pending = addr;
+    s_enabled_pending = port != 0;
+    need_target_update = true;
+}
+
+bool udp_stream_target_pending(void) {
+    return need_target_update;
+}
+
+bool udp_stream_enabled(void) {
+    // A pending change counts, or the ADC task would never call send() to pick it up
+    return s_enabled || need_target_update;
+}
+
+void udp_stream_reconfig(uint32_t sample_rate) {
+    scope_udp_tx_reconfig(&s_tx, sample_rate);
+}
+
+bool udp_stream_send(const uint16_t* samples, size_t n, uint32_t t_us) {
+    bool reopen = s_sock < 0;
+    if (need_target_update) {
+        s_target = s_target_pending;
+        s_enabled = s_enabled_pending;
+        need_target_update = false; // after the copy
+        reopen = true;
+    }
+    if (!s_enabled) return false;
+
+    if (reopen) {
+        if (!open_socket()) {
+            s_enabled = false;
+            return false;
+        }
+    }
+
+    int dgrams = (n + s_tx.max_samples - 1) / s_tx.max_samples;
+    int dropped = scope_udp_tx_frame(&s_tx, samples, n, t_us, send_dgram, NULL);
+    s_drops += dropped;
+
+    // Don't spam the log at frame rate, just every few hundred drops
+    if (s_drops - s_drops_logged >= 256) {
+        ESP_LOGW(TAG, "%" PRIu32 " datagrams dropped on send so far", s_drops);
+        s_drops_logged = s_drops;
+    }
+    return dropped < dgrams;
+}
@@ -0,0 +1,32 @@
+#ifndef UDP_STREAM_H
+#define UDP_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Optional UDP sample stream (see scope_udp.h for the wire format).
+// Unlike the /signal WebSocket this sends every ADC frame and never retransmits:
+// a lost datagram is just a gap the receiver can see and report.
+
+// Loads the boot default from Kconfig (CONFIG_SCOPE_UDP_*)
+void udp_stream_init(uint32_t sample_rate);
+
+// Point the stream somewhere else at runtime. port 0 turns it off.
+// Safe to call from the httpd task: the ADC task copies the new target on its
+// next frame and (re)opens the socket. Ignored while the last one is pending.
+void udp_stream_set_target(const char* host, uint16_t port);
+
+// True until the ADC task has picked up the last udp_stream_set_target()
+bool udp_stream_target_pending(void);
+
+bool udp_stream_enabled(void);
+
+// Call from the ADC task after it re-inits the ADC with a new rate
+void udp_stream_reconfig(uint32_t sample_rate);
+
+// Call from the ADC task with every converted frame.
+// Returns true if at least one datagram of it made it out.
+bool udp_stream_send(const uint16_t* samples, size_t n, uint32_t t_us);
+
+#endif // UDP_STREAM_H
@@ -1,5 +1,8 @@
 #include "wifi_manager.h"
+#include <stdlib.h>
 #include <string.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
 #include "esp_mac.h"
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
@@ -11,9 +14,11 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "scope_wifi_cache.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "lwip/sockets.h"
+#include "ping/ping_sock.h"
 #include "cJSON.h"
 
 // Logs
@@ -36,6 +41,28 @@ static httpd_handle_t s_server_handle = NULL;
 // Current NVS specified ssid
 static char ssid[33] = {0};
 
+static esp_netif_t *s_sta_netif = NULL;
+static int64_t s_got_ip_us = 0;
+
+// Fast start: last AP + lease, so we can skip the all-channel scan (and DHCP)
+#ifdef CONFIG_SCOPE_FAST_BOOT
+// Give the cached BSSID this many tries before falling back to a full scan
+#define FAST_CACHE_MAX_FAILS 2
+
+static scope_wifi_cache_t s_cache;
+static bool s_using_cache = false;
+static int s_cache_fails = 0;
+#endif
+#ifdef CONFIG_SCOPE_FAST_BOOT_STATIC_IP
+static bool s_lease_reused = false; // static IP from the cache, not from DHCP
+#endif
+
+// Our own events, so work that has to happen on the event loop can be handed over
+ESP_EVENT_DEFINE_BASE(SCOPE_WIFI_EVENT);
+enum {
+    SCOPE_WIFI_EVENT_LEASE_STALE, // gateway didn't answer on the reused lease
+};
+
 // Forward decls
 
 static void wifi_init_softap(void);
@@ -50,19 +77,141 @@ bool is_connected(void) {
     return xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, 1) & WIFI_CONNECTED_BIT;
 }
 
+// -------------------------------------------------------------------------
+// Fast Start Cache (stored next to the credentials, see scope_wifi_cache.h)
+// -------------------------------------------------------------------------
+#ifdef CONFIG_SCOPE_FAST_BOOT
+static void fast_cache_save_task(void *arg) {
+    // NVS writes want more stack than the event loop task has, so do it here.
+    // Works on its own copy, s_cache belongs to the event loop.
+    scope_wifi_cache_t *cache = arg;
+    esp_err_t err = cache->version ? scope_wifi_cache_save(cache) : scope_wifi_cache_erase();
+    if (err != ESP_OK) ESP_LOGW(TAG, "Fast start cache not saved: %s", esp_err_to_name(err));
+    free(cache);
+    vTaskDelete(NULL);
+}
+
+static void fast_cache_store(void) {
+    scope_wifi_cache_t *copy = malloc(sizeof(*copy));
+    if (!copy) return;
+    *copy = s_cache;
+    if (xTaskCreate(fast_cache_save_task, "wifi_cache", 3072, copy, 1, NULL) != pdPASS) free(copy);
+}
+
+static void fast_cache_update(const esp_netif_ip_info_t *ip_info) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return;
+
+    scope_wifi_cache_t cache = {
+        .version = SCOPE_WIFI_CACHE_VER,
+        .channel = ap.primary,
+        .has_ip = 1,
+        .ip = ip_info->ip.addr,
+        .netmask = ip_info->netmask.addr,
+        .gw = ip_info->gw.addr,
+    };
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        cache.dns = dns.ip.u_addr.ip4.addr;
+    }
+
+    // Same as what we booted with: don't even start the task
+    if (memcmp(&cache, &s_cache, sizeof(cache)) == 0) return;
+
+    ESP_LOGI(TAG, "Caching AP " MACSTR " ch %d for fast start", MAC2STR(cache.bssid), cache.channel);
+    s_cache = cache;
+    fast_cache_store();
+}
+
+// Event loop only: it reconfigures the STA and restarts DHCP
+static void fast_cache_drop(void) {
+    s_using_cache = false;
+    s_cache_fails = 0;
+    memset(&s_cache, 0, sizeof(s_cache));
+
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
+    esp_netif_dhcpc_start(s_sta_netif);
+
+    fast_cache_store();
+}
+#endif
+
+#ifdef CONFIG_SCOPE_FAST_BOOT_STATIC_IP
+// A reused lease still associates and "gets" its IP, even if the router has
+// since given it to someone else or we're on a different subnet. Ping the
+// gateway once: no answer -> drop the cache and get a real lease.
+static void lease_check_end(esp_ping_handle_t hdl, void *args) {
+    uint32_t replies = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_REPLY, &replies, sizeof(replies));
+    esp_ping_delete_session(hdl);
+
+    // This runs on the ping task, the drop itself happens on the event loop
+    if (replies == 0) {
+        ESP_LOGW(TAG, "Gateway doesn't answer on the cached lease, switching to DHCP");
+        if (esp_event_post(SCOPE_WIFI_EVENT, SCOPE_WIFI_EVENT_LEASE_STALE, NULL, 0, pdMS_TO_TICKS(1000)) != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't post the stale lease event, keeping the cached lease");
+        }
+    }
+}
+
+static void lease_check_start(const esp_netif_ip_info_t *ip_info) {
+    esp_ping_config_t cfg = ESP_PING_DEFAULT_CONFIG();
+    cfg.target_addr.type = IPADDR_TYPE_V4;
+    cfg.target_addr.u_addr.ip4.addr = ip_info->gw.addr;
+    cfg.count = 3;
+    cfg.interval_ms = 200;
+    cfg.timeout_ms = 500;
+
+    esp_ping_callbacks_t cbs = { .on_ping_end = lease_check_end };
+    esp_ping_handle_t hdl;
+    if (esp_ping_new_session(&cfg, &cbs, &hdl) == ESP_OK) {
+        esp_ping_start(hdl);
+    }
+}
+#endif
+
 // WiFi Event Handler
 static void event_handler(void *arg, esp_event_base_t event_base,
                           int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+#ifdef CONFIG_SCOPE_FAST_BOOT
+        if (s_using_cache && ++s_cache_fails >= FAST_CACHE_MAX_FAILS) {
+            // AP moved/changed channel. Do it the slow way. (A stale lease doesn't
+            // end up here, it associates fine; see lease_check_start.)
+            ESP_LOGW(TAG, "Cached AP didn't work, falling back to full scan + DHCP");
+            fast_cache_drop();
+        }
+#endif
         ESP_LOGI(TAG, "Retry connecting to AP %s", ssid);
         esp_wifi_connect();
         // In a real product, we might count retries and switch to AP mode if failing.
         // For now, infinite retry is simple.
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        if (s_got_ip_us == 0) s_got_ip_us = esp_timer_get_time();
+#ifdef CONFIG_SCOPE_FAST_BOOT
+        ESP_LOGI(TAG, "Got IP: " IPSTR " (%lld ms after boot%s)", IP2STR(&event->ip_info.ip),
+                 s_got_ip_us / 1000, s_using_cache ? ", fast start" : "");
+        s_cache_fails = 0;
+#ifdef CONFIG_SCOPE_FAST_BOOT_STATIC_IP
+        if (s_lease_reused) {
+            s_lease_reused = false;
+            lease_check_start(&event->ip_info);
+        }
+#endif
+        fast_cache_update(&event->ip_info);
+#else
+        ESP_LOGI(TAG, "Got IP: " IPSTR " (%lld ms after boot)", IP2STR(&event->ip_info.ip), s_got_ip_us / 1000);
+#endif
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED) {
         wifi_event_ap_staconnected_t *event = (wifi_event_ap_staconnected_t *)event_data;
@@ -70,6 +219,10 @@ static void event_handler(void *arg, esp_event_base_t event_base,
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STADISCONNECTED) {
         wifi_event_ap_stadisconnected_t *event = (wifi_event_ap_stadisconnected_t *)event_data;
         ESP_LOGI(TAG, "station "MACSTR" leave, AID=%d", MAC2STR(event->mac), event->aid);
+#ifdef CONFIG_SCOPE_FAST_BOOT
+    } else if (event_base == SCOPE_WIFI_EVENT && event_id == SCOPE_WIFI_EVENT_LEASE_STALE) {
+        fast_cache_drop();
+#endif
     }
 }
 
@@ -231,6 +384,35 @@ static void wifi_init_station(const char* ssid, const char* pass) {
     strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
     strncpy((char*)wifi_config.sta.password, pass, sizeof(wifi_config.sta.password));
 
+#ifdef CONFIG_SCOPE_FAST_BOOT
+    if (scope_wifi_cache_load(&s_cache)) {
+        // Go straight for the AP we used last time: one channel, no full scan
+        ESP_LOGI(TAG, "Fast start: AP " MACSTR " on channel %d", MAC2STR(s_cache.bssid), s_cache.channel);
+        memcpy(wifi_config.sta.bssid, s_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = s_cache.channel;
+        s_using_cache = true;
+
+#ifdef CONFIG_SCOPE_FAST_BOOT_STATIC_IP
+        // Reuse the last lease instead of waiting on DHCP
+        if (s_cache.has_ip) {
+            esp_netif_ip_info_t ip_info = {
+                .ip.addr = s_cache.ip,
+                .netmask.addr = s_cache.netmask,
+                .gw.addr = s_cache.gw,
+            };
+            esp_netif_dhcpc_stop(s_sta_netif);
+            esp_netif_set_ip_info(s_sta_netif, &ip_info);
+            s_lease_reused = true;
+            if (s_cache.dns) {
+                esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4, .ip.u_addr.ip4.addr = s_cache.dns };
+                esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+            }
+        }
+#endif
+    }
+#endif
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -263,6 +445,10 @@ static esp_err_t save_wifi_handler(httpd_req_t *req) {
 
             ESP_LOGI(TAG, "Saving WiFi Credentials: SSID=%s", ssid);
 
+            // Cached AP belongs to the old network. First, so a power cut in between
+            // can't leave the new credentials pointing at the old AP.
+            scope_wifi_cache_erase();
+
             // Save to NVS
             nvs_handle_t nvs_handle;
             esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
@@ -312,8 +498,8 @@ bool wifi_manager_init_wifi(void) {
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    esp_netif_set_hostname(sta_netif, "esp-scope");
+    s_sta_netif = esp_netif_create_default_wifi_sta();
+    esp_netif_set_hostname(s_sta_netif, "esp-scope");
     esp_netif_create_default_wifi_ap();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -321,6 +507,7 @@ bool wifi_manager_init_wifi(void) {
 
     esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL);
     esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL);
+    esp_event_handler_instance_register(SCOPE_WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL);
 
     // 2. Check NVS
     nvs_handle_t nvs_handle;
@@ -349,6 +536,10 @@ bool wifi_manager_init_wifi(void) {
     }
 }
 
+int64_t wifi_manager_got_ip_time_us(void) {
+    return s_got_ip_us;
+}
+
 void wifi_manager_erase_config(void) {
     ESP_LOGW(TAG, "Erasing WiFi Config from NVS...");
     nvs_handle_t nvs_handle;
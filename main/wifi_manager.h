@@ -14,4 +14,7 @@ void wifi_manager_register_uri(httpd_handle_t server);
 void wifi_manager_erase_config(void);
 
 bool is_connected(void);
+
+// esp_timer time of the first IP_EVENT_STA_GOT_IP, 0 if we never got one (or AP mode)
+int64_t wifi_manager_got_ip_time_us(void);
 #endif // WIFI_MANAGER_H
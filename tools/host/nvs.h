@@ -0,0 +1,34 @@
+#ifndef HOST_NVS_H
+#define HOST_NVS_H
+
+// Host stand-in for IDF's nvs.h, backed by an in-memory store (nvs_stub.c).
+// Only blobs, which is all the scope_* modules use.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out);
+void nvs_close(nvs_handle_t h);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char* key, void* out, size_t* len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char* key, const void* value, size_t len);
+esp_err_t nvs_erase_key(nvs_handle_t h, const char* key);
+esp_err_t nvs_erase_all(nvs_handle_t h);
+esp_err_t nvs_commit(nvs_handle_t h);
+
+// Test hooks, not in IDF
+void nvs_stub_reset(void);
+// nvs_set_blob calls so far, to check that unchanged data isn't rewritten
+int nvs_stub_writes(void);
+// Next nvs_flash_init() returns this once (e.g. ESP_ERR_NVS_NO_FREE_PAGES)
+void nvs_stub_fail_next_init(esp_err_t err);
+int nvs_stub_erases(void);
+
+#endif // HOST_NVS_H
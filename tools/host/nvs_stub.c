@@ -0,0 +1,170 @@
+// In-memory NVS for host tests. Flat table of namespace/key -> blob, no
+// wear or page logic, but the same open/readonly/not-found rules as IDF.
+
+#include "nvs_flash.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define MAX_ENTRIES 16
+#define MAX_BLOB    64
+#define MAX_HANDLES 8
+
+typedef struct {
+    bool used;
+    char ns[16];
+    char key[16];
+    uint8_t data[MAX_BLOB];
+    size_t len;
+} entry_t;
+
+typedef struct {
+    bool open;
+    bool writable;
+    char ns[16];
+} handle_t;
+
+static entry_t s_entries[MAX_ENTRIES];
+static handle_t s_handles[MAX_HANDLES];
+static bool s_inited = false;
+static esp_err_t s_fail_init = ESP_OK;
+static int s_writes = 0;
+static int s_erases = 0;
+
+void nvs_stub_reset(void) {
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_handles, 0, sizeof(s_handles));
+    s_inited = false;
+    s_fail_init = ESP_OK;
+    s_writes = 0;
+    s_erases = 0;
+}
+
+int nvs_stub_writes(void) {
+    return s_writes;
+}
+
+int nvs_stub_erases(void) {
+    return s_erases;
+}
+
+void nvs_stub_fail_next_init(esp_err_t err) {
+    s_fail_init = err;
+}
+
+esp_err_t nvs_flash_init(void) {
+    if (s_fail_init != ESP_OK) {
+        esp_err_t err = s_fail_init;
+        s_fail_init = ESP_OK;
+        return err;
+    }
+    s_inited = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    memset(s_entries, 0, sizeof(s_entries));
+    s_erases++;
+    return ESP_OK;
+}
+
+static entry_t* find(const char* ns, const char* key) {
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, ns) == 0 && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static handle_t* get(nvs_handle_t h) {
+    return (h >= 1 && h <= MAX_HANDLES && s_handles[h - 1].open) ? &s_handles[h - 1] : NULL;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out) {
+    if (!s_inited) return ESP_ERR_NVS_NOT_INITIALIZED;
+
+    // Like IDF: a readonly open of a namespace that was never written fails
+    if (mode == NVS_READONLY) {
+        bool exists = false;
+        for (int i = 0; i < MAX_ENTRIES; i++) {
+            if (s_entries[i].used && strcmp(s_entries[i].ns, name) == 0) exists = true;
+        }
+        if (!exists) return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    for (int i = 0; i < MAX_HANDLES; i++) {
+        if (!s_handles[i].open) {
+            s_handles[i].open = true;
+            s_handles[i].writable = mode == NVS_READWRITE;
+            strncpy(s_handles[i].ns, name, sizeof(s_handles[i].ns) - 1);
+            *out = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t h) {
+    handle_t* hd = get(h);
+    if (hd) hd->open = false;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char* key, void* out, size_t* len) {
+    handle_t* hd = get(h);
+    if (!hd) return ESP_ERR_INVALID_ARG;
+
+    entry_t* e = find(hd->ns, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (!out) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, e->data, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char* key, const void* value, size_t len) {
+    handle_t* hd = get(h);
+    if (!hd || !hd->writable || len > MAX_BLOB) return ESP_ERR_INVALID_ARG;
+
+    entry_t* e = find(hd->ns, key);
+    for (int i = 0; !e && i < MAX_ENTRIES; i++) {
+        if (!s_entries[i].used) e = &s_entries[i];
+    }
+    if (!e) return ESP_ERR_NO_MEM;
+
+    e->used = true;
+    strncpy(e->ns, hd->ns, sizeof(e->ns) - 1);
+    strncpy(e->key, key, sizeof(e->key) - 1);
+    memcpy(e->data, value, len);
+    e->len = len;
+    s_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char* key) {
+    handle_t* hd = get(h);
+    if (!hd || !hd->writable) return ESP_ERR_INVALID_ARG;
+
+    entry_t* e = find(hd->ns, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    e->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h) {
+    handle_t* hd = get(h);
+    if (!hd || !hd->writable) return ESP_ERR_INVALID_ARG;
+
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, hd->ns) == 0) s_entries[i].used = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h) {
+    return get(h) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,145 @@
+#define _GNU_SOURCE // mremap
+#include "scope_capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scope_codec.h"
+
+// Grow in big steps so mremap/ftruncate stay off the per-frame path
+#define SCAP_GROW (64u * 1024 * 1024)
+
+static bool ensure_space(scap_writer_t* w, size_t need) {
+    if (w->pos + need <= w->map_len) return true;
+
+    size_t new_len = w->map_len;
+    while (w->pos + need > new_len) new_len += SCAP_GROW;
+
+    if (ftruncate(w->fd, (off_t)new_len) < 0) {
+        perror("ftruncate");
+        return false;
+    }
+    void* m = mremap(w->map, w->map_len, new_len, MREMAP_MAYMOVE);
+    if (m == MAP_FAILED) {
+        perror("mremap");
+        return false;
+    }
+    w->map = m;
+    w->map_len = new_len;
+    return true;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+static void put_u64(uint8_t* p, uint64_t v) { memcpy(p, &v, 8); }
+
+bool scap_open(scap_writer_t* w, const char* path, const char* source, uint32_t sample_rate) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        perror(path);
+        return false;
+    }
+    if (ftruncate(w->fd, SCAP_GROW) < 0) {
+        perror("ftruncate");
+        close(w->fd);
+        unlink(path);
+        return false;
+    }
+    w->map = mmap(NULL, SCAP_GROW, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+    if (w->map == MAP_FAILED) {
+        perror("mmap");
+        close(w->fd);
+        unlink(path);
+        return false;
+    }
+    w->map_len = SCAP_GROW;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    scap_hdr_t* h = (scap_hdr_t*)w->map;
+    memcpy(h->magic, SCAP_MAGIC, 8);
+    h->version = SCAP_VERSION;
+    h->hdr_len = SCAP_HDR_LEN;
+    h->sample_rate = sample_rate;
+    h->start_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    snprintf(h->source, sizeof(h->source), "%s", source);
+
+    w->pos = SCAP_HDR_LEN;
+    h->data_end = w->pos;
+    return true;
+}
+
+bool scap_append(scap_writer_t* w, const uint8_t* payload, size_t n_samples, uint64_t t_us) {
+    size_t body = scope_codec_len(n_samples);
+    size_t total = (SCAP_CHUNK_HDR + body + 7) & ~(size_t)7;
+
+    if (!ensure_space(w, total)) return false;
+
+    uint8_t* p = w->map + w->pos;
+    put_u32(p, SCAP_CHUNK_MAGIC);
+    put_u32(p + 4, (uint32_t)n_samples);
+    put_u64(p + 8, w->seq);
+    put_u64(p + 16, t_us);
+    put_u64(p + 24, w->samples);
+    // Already in the on-disk encoding, so no decode/re-encode round trip
+    memcpy(p + SCAP_CHUNK_HDR, payload, body);
+    memset(p + SCAP_CHUNK_HDR + body, 0, total - SCAP_CHUNK_HDR - body);
+
+    if (w->index_len == w->index_cap) {
+        size_t cap = w->index_cap ? w->index_cap * 2 : 4096;
+        scap_index_t* idx = realloc(w->index, cap * sizeof(*idx));
+        if (!idx) return false;
+        w->index = idx;
+        w->index_cap = cap;
+    }
+    w->index[w->index_len++] = (scap_index_t){ w->pos, t_us, w->samples };
+
+    w->pos += total;
+    w->seq++;
+    w->samples += n_samples;
+    ((scap_hdr_t*)w->map)->data_end = w->pos;
+    return true;
+}
+
+void scap_close(scap_writer_t* w) {
+    if (!w->map) return;
+
+    size_t idx_bytes = w->index_len * sizeof(scap_index_t);
+    scap_hdr_t* h = (scap_hdr_t*)w->map;
+
+    if (ensure_space(w, idx_bytes)) {
+        h = (scap_hdr_t*)w->map;
+        memcpy(w->map + w->pos, w->index, idx_bytes);
+        h->index_offset = w->pos;
+        h->index_count = w->index_len;
+        w->pos += idx_bytes;
+    }
+
+    msync(w->map, w->pos, MS_SYNC);
+    munmap(w->map, w->map_len);
+    if (ftruncate(w->fd, (off_t)w->pos) < 0) perror("ftruncate");
+    close(w->fd);
+    free(w->index);
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+}
+
+void scap_discard(scap_writer_t* w) {
+    if (!w->map) return;
+
+    munmap(w->map, w->map_len);
+    close(w->fd);
+    unlink(w->path);
+    free(w->index);
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+}
@@ -0,0 +1,70 @@
+#ifndef SCOPE_CAPTURE_H
+#define SCOPE_CAPTURE_H
+
+// Chunk-indexed capture file, written through a growing mmap so appending a
+// frame is a memcpy and the kernel does the I/O.
+//
+// Layout, all little-endian:
+//   file header  (SCAP_HDR_LEN bytes)
+//   chunk*       one per received frame, 8-byte aligned:
+//                  u32 magic 'CHNK', u32 count, u64 seq, u64 t_us, u64 first_sample,
+//                  u16 samples[count] (scope_codec.h), zero padding to 8
+//   index        (written on close) u64 offset, u64 t_us, u64 first_sample per chunk
+//
+// The header's data_end is bumped after every chunk, so if we get killed the
+// chunks up to data_end are still valid and can be walked without the index.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCAP_MAGIC        "SCAPTURE"
+#define SCAP_VERSION      1
+#define SCAP_HDR_LEN      128
+#define SCAP_CHUNK_MAGIC  0x4b4e4843 // "CHNK"
+#define SCAP_CHUNK_HDR    32
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t hdr_len;
+    uint32_t sample_rate;   // nominal, as given on the command line
+    uint32_t flags;
+    uint64_t data_end;      // end of the last complete chunk
+    uint64_t index_offset;  // 0 if the file wasn't closed cleanly
+    uint64_t index_count;
+    uint64_t start_us;      // CLOCK_REALTIME at open
+    char     source[64];    // device host:port
+} scap_hdr_t;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t t_us;
+    uint64_t first_sample;
+} scap_index_t;
+
+typedef struct {
+    int      fd;
+    uint8_t* map;
+    size_t   map_len;
+    uint64_t pos;
+    uint64_t seq;
+    uint64_t samples;
+    scap_index_t* index;
+    size_t   index_len;
+    size_t   index_cap;
+    char     path[256];
+} scap_writer_t;
+
+bool scap_open(scap_writer_t* w, const char* path, const char* source, uint32_t sample_rate);
+
+// payload is an encoded frame straight off the wire, n_samples long
+bool scap_append(scap_writer_t* w, const uint8_t* payload, size_t n_samples, uint64_t t_us);
+
+// Writes the index, trims the file and unmaps
+void scap_close(scap_writer_t* w);
+
+// Unmaps, closes and deletes the file, for when the recording never started
+void scap_discard(scap_writer_t* w);
+
+#endif // SCOPE_CAPTURE_H
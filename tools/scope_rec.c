@@ -0,0 +1,528 @@
+// scope_rec - headless /signal recorder for Linux.
+//
+// Connects to one or more ESP-Scope devices over WebSocket, decodes the frames
+// with scope_codec.h (same as the firmware) and appends them to a
+// chunk-indexed capture file per device (see scope_capture.h). Everything runs
+// in one epoll loop, so recording N devices costs one mostly-idle thread.
+//
+//   ./scope_rec -r 20000 192.168.1.40 192.168.1.41:8080
+//
+// Prints per-device throughput, coverage and CPU once a second. The device
+// only sends every 2nd ADC frame, so coverage is against half the nominal
+// rate: 100% means nothing was dropped on the way (e.g. when WiFi is busy).
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "scope_capture.h"
+#include "scope_codec.h"
+#include "scope_decode.h"
+#include "scope_ws.h"
+
+#define MAX_DEVICES     16
+#define RX_BUF_LEN      (256 * 1024)
+#define MAX_FRAME_LEN   (RX_BUF_LEN - WS_MAX_HDR)
+#define RECONNECT_US    2000000 // same 2s as the browser page
+
+typedef enum {
+    ST_IDLE,
+    ST_CONNECTING,
+    ST_HANDSHAKE,
+    ST_STREAMING,
+} dev_state_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t samples;
+    uint64_t bytes;
+    uint64_t bad_frames;  // odd length, out-of-range codes, unexpected opcodes
+    uint64_t decode_events; // UART bytes etc. from the on-device decoder, not recorded
+    uint64_t write_errors;
+    uint64_t reconnects;
+} dev_stats_t;
+
+typedef struct {
+    char name[80];
+    char host[64];
+    int port;
+    struct sockaddr_in addr;
+
+    int fd;
+    dev_state_t st;
+    char key[25];
+    int64_t retry_at;
+
+    uint8_t* rx;
+    size_t rx_len;
+
+    scap_writer_t cap;
+    dev_stats_t stats;
+    dev_stats_t prev;
+    uint16_t min_code, max_code;
+} device_t;
+
+static device_t s_devs[MAX_DEVICES];
+static int s_num_devs = 0;
+static int s_epoll = -1;
+static uint32_t s_rate = 20000;
+
+// main.c sends every 2nd ADC frame over /signal, see the throttle in adc_task
+#define WS_FRAME_EVERY 2
+static bool s_quiet = false;
+static volatile sig_atomic_t s_stop = 0;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t wall_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    s_stop = 1;
+}
+
+// -------------------------------------------------------------------------
+// Connection handling
+// -------------------------------------------------------------------------
+
+static void dev_disconnect(device_t* d, const char* why) {
+    if (d->fd >= 0) {
+        epoll_ctl(s_epoll, EPOLL_CTL_DEL, d->fd, NULL);
+        close(d->fd);
+        d->fd = -1;
+    }
+    if (d->st != ST_IDLE) {
+        fprintf(stderr, "[%s] disconnected: %s, retrying in %ds\n", d->name, why, RECONNECT_US / 1000000);
+    }
+    d->st = ST_IDLE;
+    d->rx_len = 0;
+    d->retry_at = now_us() + RECONNECT_US;
+}
+
+static void dev_connect(device_t* d) {
+    d->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (d->fd < 0) {
+        perror("socket");
+        d->retry_at = now_us() + RECONNECT_US;
+        return;
+    }
+
+    // Frames are small and we never send anything latency sensitive, but the
+    // pong for a ping shouldn't sit in Nagle's buffer either
+    int one = 1;
+    setsockopt(d->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rcvbuf = 1024 * 1024;
+    setsockopt(d->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP, .data.ptr = d };
+    epoll_ctl(s_epoll, EPOLL_CTL_ADD, d->fd, &ev);
+
+    d->st = ST_CONNECTING;
+    d->stats.reconnects++;
+    if (connect(d->fd, (struct sockaddr*)&d->addr, sizeof(d->addr)) < 0 && errno != EINPROGRESS) {
+        dev_disconnect(d, strerror(errno));
+    }
+}
+
+static bool send_all(device_t* d, const void* buf, size_t len) {
+    // Only used for the handshake and tiny control frames, which always fit
+    // in an empty socket buffer
+    return send(d->fd, buf, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static bool send_ctrl(device_t* d, uint8_t opcode, const uint8_t* payload, size_t len) {
+    // Client frames must be masked (RFC 6455 5.3)
+    uint8_t frame[WS_MAX_HDR + 125];
+    uint8_t mask[4] = { (uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand() };
+    if (len > 125) len = 125;
+
+    int h = ws_write_hdr(frame, opcode, len, mask);
+    memcpy(frame + h, payload, len);
+    ws_unmask(frame + h, len, mask, 0);
+    return send_all(d, frame, h + len);
+}
+
+static void dev_on_connected(device_t* d) {
+    int err = 0;
+    socklen_t el = sizeof(err);
+    getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &err, &el);
+    if (err) {
+        dev_disconnect(d, strerror(err));
+        return;
+    }
+
+    ws_make_key(d->key);
+    char req[512];
+    int n = snprintf(req, sizeof(req),
+                     "GET /signal HTTP/1.1\r\n"
+                     "Host: %s:%d\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\n"
+                     "Sec-WebSocket-Version: 13\r\n"
+                     "\r\n",
+                     d->host, d->port, d->key);
+    if (!send_all(d, req, (size_t)n)) {
+        dev_disconnect(d, "handshake send failed");
+        return;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = d };
+    epoll_ctl(s_epoll, EPOLL_CTL_MOD, d->fd, &ev);
+    d->st = ST_HANDSHAKE;
+}
+
+static bool dev_check_handshake(device_t* d) {
+    uint8_t* end = memmem(d->rx, d->rx_len, "\r\n\r\n", 4);
+    if (!end) {
+        if (d->rx_len > 4096) dev_disconnect(d, "handshake too long");
+        return false;
+    }
+    *end = 0;
+    size_t hdr_len = (size_t)(end - d->rx) + 4;
+
+    if (strncmp((char*)d->rx, "HTTP/1.1 101", 12) != 0) {
+        dev_disconnect(d, "not a WebSocket endpoint");
+        return false;
+    }
+
+    char expect[29];
+    ws_accept_key(d->key, expect);
+    char* acc = strcasestr((char*)d->rx, "Sec-WebSocket-Accept:");
+    if (acc) {
+        acc += strlen("Sec-WebSocket-Accept:");
+        while (*acc == ' ') acc++;
+    }
+    if (!acc || strncmp(acc, expect, strlen(expect)) != 0) {
+        dev_disconnect(d, "bad Sec-WebSocket-Accept");
+        return false;
+    }
+
+    // Whatever came after the headers is already frame data
+    memmove(d->rx, d->rx + hdr_len, d->rx_len - hdr_len);
+    d->rx_len -= hdr_len;
+    d->st = ST_STREAMING;
+    fprintf(stderr, "[%s] streaming\n", d->name);
+
+    // The firmware doesn't need it anymore, but the page sends it, so we do too
+    send_ctrl(d, WS_OP_TEXT, (const uint8_t*)"hello", 5);
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Frames
+// -------------------------------------------------------------------------
+
+static void on_samples(device_t* d, const uint8_t* payload, size_t len) {
+    // Decoder event frames start with a word no 12-bit sample can have
+    if (len >= SCOPE_DECODE_HDR_LEN && (payload[0] | (payload[1] << 8)) == SCOPE_DECODE_MAGIC) {
+        d->stats.decode_events += payload[2] | (payload[3] << 8);
+        return;
+    }
+    if (len & 1) {
+        d->stats.bad_frames++;
+        return;
+    }
+    size_t n = len / SCOPE_CODEC_BYTES_PER_SAMPLE;
+
+    // Decode only to sanity check and track the range; the capture file keeps
+    // the wire encoding as-is.
+    static uint16_t samples[MAX_FRAME_LEN / SCOPE_CODEC_BYTES_PER_SAMPLE];
+    scope_codec_decode(samples, payload, n);
+    uint16_t lo = d->min_code, hi = d->max_code;
+    for (size_t i = 0; i < n; i++) {
+        uint16_t v = samples[i];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    d->min_code = lo;
+    d->max_code = hi;
+    if (hi > SCOPE_CODEC_MAX_CODE) d->stats.bad_frames++;
+
+    if (d->cap.map && !scap_append(&d->cap, payload, n, wall_us())) d->stats.write_errors++;
+
+    d->stats.frames++;
+    d->stats.samples += n;
+}
+
+// Returns false if the connection went away
+static bool dev_parse_frames(device_t* d) {
+    size_t pos = 0;
+
+    while (pos < d->rx_len) {
+        ws_frame_hdr_t fh;
+        int h = ws_parse_hdr(d->rx + pos, d->rx_len - pos, &fh);
+        if (h < 0 || fh.len > MAX_FRAME_LEN) {
+            dev_disconnect(d, "bad frame");
+            return false;
+        }
+        if (h == 0 || d->rx_len - pos < h + fh.len) break; // need more bytes
+
+        uint8_t* payload = d->rx + pos + h;
+        if (fh.masked) ws_unmask(payload, fh.len, fh.mask, 0);
+
+        switch (fh.opcode) {
+            case WS_OP_BINARY:
+            case WS_OP_CONT:
+                on_samples(d, payload, fh.len);
+                break;
+            case WS_OP_PING:
+                send_ctrl(d, WS_OP_PONG, payload, fh.len);
+                break;
+            case WS_OP_CLOSE:
+                send_ctrl(d, WS_OP_CLOSE, payload, fh.len < 2 ? fh.len : 2);
+                dev_disconnect(d, "closed by device");
+                return false;
+            case WS_OP_TEXT:
+            case WS_OP_PONG:
+                break;
+            default:
+                d->stats.bad_frames++;
+                break;
+        }
+        pos += h + fh.len;
+    }
+
+    if (pos > 0) {
+        memmove(d->rx, d->rx + pos, d->rx_len - pos);
+        d->rx_len -= pos;
+    }
+    return true;
+}
+
+static void dev_on_readable(device_t* d) {
+    // Drain whatever is there, fewer epoll round trips per frame
+    while (d->fd >= 0) {
+        if (d->rx_len == RX_BUF_LEN) {
+            dev_disconnect(d, "rx buffer overflow");
+            return;
+        }
+        ssize_t n = recv(d->fd, d->rx + d->rx_len, RX_BUF_LEN - d->rx_len, 0);
+        if (n == 0) {
+            dev_disconnect(d, "connection closed");
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            dev_disconnect(d, strerror(errno));
+            return;
+        }
+        d->rx_len += (size_t)n;
+        d->stats.bytes += (uint64_t)n;
+
+        if (d->st == ST_HANDSHAKE && !dev_check_handshake(d)) continue;
+        if (d->st == ST_STREAMING && !dev_parse_frames(d)) return;
+    }
+}
+
+// -------------------------------------------------------------------------
+// Stats
+// -------------------------------------------------------------------------
+
+static void print_stats(double secs, double cpu_pct) {
+    for (int i = 0; i < s_num_devs; i++) {
+        device_t* d = &s_devs[i];
+        dev_stats_t* s = &d->stats;
+        dev_stats_t* p = &d->prev;
+        double sps = (s->samples - p->samples) / secs;
+        double coverage = s_rate ? 100.0 * sps * WS_FRAME_EVERY / s_rate : 0;
+
+        fprintf(stderr,
+                "[%s] %6.1f fps %8.1f ksps %8.1f kB/s | coverage %5.1f%% | codes %4u..%-4u | bad %" PRIu64
+                " werr %" PRIu64 " reconn %" PRIu64 " decoded %" PRIu64 "\n",
+                d->name, (s->frames - p->frames) / secs, sps / 1000.0, (s->bytes - p->bytes) / secs / 1000.0,
+                coverage, d->max_code >= d->min_code ? d->min_code : 0, d->max_code,
+                s->bad_frames, s->write_errors, s->reconnects > 0 ? s->reconnects - 1 : 0,
+                s->decode_events - p->decode_events);
+
+        *p = *s;
+        d->min_code = UINT16_MAX;
+        d->max_code = 0;
+    }
+    fprintf(stderr, "cpu %.2f%%\n", cpu_pct);
+}
+
+static int64_t cpu_us(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// -------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------
+
+static bool add_device(const char* spec, const char* prefix) {
+    if (s_num_devs == MAX_DEVICES) {
+        fprintf(stderr, "too many devices (max %d)\n", MAX_DEVICES);
+        return false;
+    }
+    device_t* d = &s_devs[s_num_devs];
+    memset(d, 0, sizeof(*d));
+    d->fd = -1;
+    d->port = 80;
+    d->min_code = UINT16_MAX;
+
+    char host[64];
+    snprintf(host, sizeof(host), "%s", spec);
+    char* colon = strchr(host, ':');
+    if (colon) {
+        *colon = 0;
+        d->port = atoi(colon + 1);
+    }
+    memcpy(d->host, host, sizeof(host));
+    snprintf(d->name, sizeof(d->name), "%s:%d", host, d->port);
+
+    for (int i = 0; i < s_num_devs; i++) {
+        if (strcmp(s_devs[i].name, d->name) == 0) {
+            fprintf(stderr, "%s given twice\n", d->name);
+            return false;
+        }
+    }
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(d->host, NULL, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "can't resolve %s\n", d->host);
+        return false;
+    }
+    d->addr = *(struct sockaddr_in*)res->ai_addr;
+    d->addr.sin_port = htons(d->port);
+    freeaddrinfo(res);
+
+    d->rx = malloc(RX_BUF_LEN);
+    if (!d->rx) return false;
+
+    if (prefix) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s%s_%d.scap", prefix, d->host, d->port);
+        if (!scap_open(&d->cap, path, d->name, s_rate)) {
+            free(d->rx);
+            d->rx = NULL;
+            return false;
+        }
+        fprintf(stderr, "[%s] recording to %s\n", d->name, path);
+    }
+
+    s_num_devs++;
+    return true;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-o prefix] [-n] [-r rate] [-t seconds] [-q] host[:port] ...\n"
+            "  -o  capture file prefix (default \"capture_\"), files are <prefix><host>_<port>.scap\n"
+            "  -n  don't record, just show stats\n"
+            "  -r  device sample rate, coverage is against half of it (default %" PRIu32 ")\n"
+            "  -t  stop after this many seconds\n"
+            "  -q  no per-second stats\n",
+            argv0, s_rate);
+}
+
+int main(int argc, char** argv) {
+    const char* prefix = "capture_";
+    double run_secs = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:nr:t:qh")) != -1) {
+        switch (opt) {
+            case 'o': prefix = optarg; break;
+            case 'n': prefix = NULL; break;
+            case 'r': s_rate = (uint32_t)atoi(optarg); break;
+            case 't': run_secs = atof(optarg); break;
+            case 'q': s_quiet = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    srand((unsigned)wall_us());
+    s_epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    for (int i = optind; i < argc; i++) {
+        if (!add_device(argv[i], prefix)) {
+            // Don't leave 64MB half-made files behind for the ones already opened
+            for (int j = 0; j < s_num_devs; j++) {
+                scap_discard(&s_devs[j].cap);
+                free(s_devs[j].rx);
+            }
+            close(s_epoll);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < s_num_devs; i++) dev_connect(&s_devs[i]);
+
+    int64_t start = now_us();
+    int64_t last_report = start;
+    int64_t last_cpu = cpu_us();
+    struct epoll_event events[MAX_DEVICES];
+
+    while (!s_stop) {
+        int n = epoll_wait(s_epoll, events, MAX_DEVICES, 100);
+        for (int i = 0; i < n; i++) {
+            device_t* d = events[i].data.ptr;
+            if (d->st == ST_CONNECTING && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                dev_on_connected(d);
+            } else if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                dev_on_readable(d);
+            }
+        }
+
+        int64_t t = now_us();
+        for (int i = 0; i < s_num_devs; i++) {
+            if (s_devs[i].st == ST_IDLE && t >= s_devs[i].retry_at) dev_connect(&s_devs[i]);
+        }
+
+        if (t - last_report >= 1000000) {
+            int64_t c = cpu_us();
+            if (!s_quiet) print_stats((t - last_report) / 1e6, 100.0 * (c - last_cpu) / (t - last_report));
+            last_cpu = c;
+            last_report = t;
+        }
+        if (run_secs > 0 && t - start >= (int64_t)(run_secs * 1e6)) break;
+    }
+
+    for (int i = 0; i < s_num_devs; i++) {
+        device_t* d = &s_devs[i];
+        if (d->fd >= 0) close(d->fd);
+        scap_close(&d->cap);
+        fprintf(stderr, "[%s] %" PRIu64 " frames, %" PRIu64 " samples, %" PRIu64 " bad, %" PRIu64 " write errors\n",
+                d->name, d->stats.frames, d->stats.samples, d->stats.bad_frames, d->stats.write_errors);
+        free(d->rx);
+    }
+    close(s_epoll);
+    return 0;
+}
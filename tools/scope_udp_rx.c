@@ -0,0 +1,272 @@
+// scope_udp_rx - receives the ESP-Scope UDP sample stream on Linux.
+//
+// Puts datagrams back in order (small reorder window), reports loss, jitter and
+// throughput once a second, and writes the samples to a file as raw
+// little-endian uint16. Samples lost in transit are written as 0xFFFF (out of
+// the 12-bit ADC range) so the file stays time-aligned, unless -n is given.
+//
+//   ./scope_udp_rx -p 5005 -o capture.u16
+//
+// numpy: np.fromfile("capture.u16", dtype="<u2")
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "scope_codec.h"
+#include "scope_udp.h"
+
+#define REORDER_WINDOW  32
+#define GAP_FILL        0xFFFF
+// A bogus first_sample shouldn't make us write gigabytes of fill
+#define MAX_GAP_FILL    (10 * 1000 * 1000)
+
+typedef struct {
+    bool valid;
+    scope_udp_hdr_t hdr;
+    uint16_t samples[SCOPE_UDP_MAX_SAMPLES];
+} slot_t;
+
+static slot_t s_slots[REORDER_WINDOW];
+static uint32_t s_next_seq;     // next seq to write out
+static uint32_t s_next_sample;  // first_sample we expect to write next
+static bool s_fill_gaps = true;
+static FILE* s_out = NULL;
+static uint64_t s_filled = 0;
+static volatile sig_atomic_t s_stop = 0;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    s_stop = 1;
+}
+
+static void write_slot(slot_t* slot) {
+    if (s_out) {
+        uint32_t gap = slot->hdr.first_sample - s_next_sample;
+        if (s_fill_gaps && gap > 0 && gap <= MAX_GAP_FILL && !(slot->hdr.flags & SCOPE_UDP_FLAG_RECONFIG)) {
+            static const uint16_t fill[256] = { [0 ... 255] = GAP_FILL };
+            s_filled += gap;
+            while (gap > 0) {
+                uint32_t n = gap > 256 ? 256 : gap;
+                fwrite(fill, sizeof(uint16_t), n, s_out);
+                gap -= n;
+            }
+        }
+        fwrite(slot->samples, sizeof(uint16_t), slot->hdr.count, s_out);
+    }
+    s_next_sample = slot->hdr.first_sample + slot->hdr.count;
+    slot->valid = false;
+}
+
+// Writes out everything in order up to the first hole
+static void flush_ready(void) {
+    slot_t* slot;
+    while ((slot = &s_slots[s_next_seq % REORDER_WINDOW])->valid && slot->hdr.seq == s_next_seq) {
+        write_slot(slot);
+        s_next_seq++;
+    }
+}
+
+// Gives up on holes until seq fits in the window
+static void advance_to(uint32_t seq) {
+    while ((int32_t)(seq - s_next_seq) >= REORDER_WINDOW) {
+        slot_t* slot = &s_slots[s_next_seq % REORDER_WINDOW];
+        if (slot->valid && slot->hdr.seq == s_next_seq) write_slot(slot);
+        s_next_seq++;
+        flush_ready();
+    }
+}
+
+static void flush_all(void) {
+    for (int i = 0; i < REORDER_WINDOW; i++) {
+        slot_t* slot = &s_slots[s_next_seq % REORDER_WINDOW];
+        if (slot->valid && slot->hdr.seq == s_next_seq) write_slot(slot);
+        s_next_seq++;
+    }
+}
+
+// restart: scope_udp_rx_is_restart() said hdr starts a new stream (first
+// datagram, device reboot or reconfig)
+static void reassemble(const scope_udp_hdr_t* hdr, const uint8_t* payload, bool restart) {
+    if (restart) {
+        flush_all();
+        memset(s_slots, 0, sizeof(s_slots));
+        s_next_seq = hdr->seq;
+        s_next_sample = hdr->first_sample;
+    }
+
+    int32_t ahead = (int32_t)(hdr->seq - s_next_seq);
+    if (ahead < 0) return; // already written (or filled) past this one
+
+    advance_to(hdr->seq);
+
+    slot_t* slot = &s_slots[hdr->seq % REORDER_WINDOW];
+    if (slot->valid && slot->hdr.seq == hdr->seq) return; // duplicate
+    slot->valid = true;
+    slot->hdr = *hdr;
+    scope_codec_decode(slot->samples, payload, hdr->count);
+
+    flush_ready();
+}
+
+static void print_stats(const scope_udp_rx_t* rx, const scope_udp_rx_t* prev, double secs, uint32_t rate) {
+    uint64_t rx_n = rx->received - prev->received;
+    int64_t lost_n = (int64_t)(rx->lost - prev->lost);
+    int64_t dev_n = (int64_t)(rx->tx_drops - prev->tx_drops);
+    // lost counts every seq gap, tx_drops says which of them never left the device.
+    // Late arrivals can take lost back down a second later, hence the clamp.
+    int64_t net_n = (lost_n > dev_n) ? lost_n - dev_n : 0;
+    double loss_pct = (rx_n + lost_n) ? 100.0 * lost_n / (rx_n + lost_n) : 0.0;
+
+    fprintf(stderr,
+            "%7.1f ksps %8.1f kB/s | dgrams %6" PRIu64 " lost %4" PRId64 " (%5.2f%%) = net %4" PRId64
+            " + device %4" PRId64 ", late %" PRIu64 " dup %" PRIu64 " | jitter %6.2f ms | %" PRIu32 " Hz\n",
+            (rx->samples - prev->samples) / secs / 1000.0,
+            (rx->bytes - prev->bytes) / secs / 1000.0,
+            rx_n, lost_n, loss_pct, net_n, dev_n,
+            rx->late - prev->late, rx->duplicates - prev->duplicates,
+            rx->jitter_us / 1000.0, rate);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-p port] [-b bind_addr] [-o file] [-n] [-t seconds]\n"
+            "  -p  UDP port to listen on (default %d)\n"
+            "  -b  local address to bind (default any)\n"
+            "  -o  write samples to file as raw little-endian uint16\n"
+            "  -n  don't fill lost samples with 0x%04X\n"
+            "  -t  stop after this many seconds\n",
+            argv0, SCOPE_UDP_DEFAULT_PORT, GAP_FILL);
+}
+
+int main(int argc, char** argv) {
+    int port = SCOPE_UDP_DEFAULT_PORT;
+    const char* bind_addr = NULL;
+    const char* out_path = NULL;
+    double run_secs = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:b:o:nt:h")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'b': bind_addr = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'n': s_fill_gaps = false; break;
+            case 't': run_secs = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    // Bursts of a whole ADC frame arrive back to back, give the kernel some room
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind_addr && inet_pton(AF_INET, bind_addr, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad bind address %s\n", bind_addr);
+        return 2;
+    }
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    // Wake up at least every 200ms so stats and -t still work when nothing arrives
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (out_path) {
+        s_out = fopen(out_path, "wb");
+        if (!s_out) {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fprintf(stderr, "Listening on UDP port %d\n", port);
+
+    scope_udp_rx_t rx, prev;
+    scope_udp_rx_init(&rx);
+    prev = rx;
+
+    uint8_t buf[2048];
+    uint32_t rate = 0;
+    int64_t start = now_us();
+    int64_t last_report = start;
+
+    while (!s_stop) {
+        ssize_t len = recv(sock, buf, sizeof(buf), 0);
+        int64_t t = now_us();
+
+        if (len >= 0) {
+            scope_udp_hdr_t hdr;
+            if (!scope_udp_read_hdr(buf, (size_t)len, &hdr)) {
+                // not ours
+            } else if (scope_udp_rx_is_stale(&rx, &hdr)) {
+                // Straggler from before the device rebooted: counted, not written
+                scope_udp_rx_account(&rx, &hdr, (size_t)len, t);
+            } else {
+                if (hdr.sample_rate != rate) {
+                    rate = hdr.sample_rate;
+                    fprintf(stderr, "Sample rate %" PRIu32 " Hz\n", rate);
+                }
+                bool restart = scope_udp_rx_is_restart(&rx, &hdr);
+                if (restart && rx.started) fprintf(stderr, "Stream restarted (session %08" PRIx32 ")\n", hdr.session);
+                scope_udp_rx_account(&rx, &hdr, (size_t)len, t);
+                reassemble(&hdr, buf + SCOPE_UDP_HDR_LEN, restart);
+            }
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            perror("recv");
+            break;
+        }
+
+        if (t - last_report >= 1000000) {
+            print_stats(&rx, &prev, (t - last_report) / 1e6, rate);
+            prev = rx;
+            last_report = t;
+        }
+        if (run_secs > 0 && t - start >= (int64_t)(run_secs * 1e6)) break;
+    }
+
+    flush_all();
+    if (s_out) fclose(s_out);
+    close(sock);
+
+    uint64_t total = rx.received + rx.lost;
+    fprintf(stderr,
+            "Total: %" PRIu64 " datagrams, %" PRIu64 " samples, %" PRIu64 " lost (%.3f%%) = %" PRIu64
+            " network + %" PRIu64 " dropped on device, %" PRIu64 " late, %" PRIu64 " dup, %" PRIu64
+            " from before a restart, %" PRIu64 " samples gap-filled\n",
+            rx.received, rx.samples, rx.lost, total ? 100.0 * rx.lost / total : 0.0,
+            rx.lost > rx.tx_drops ? rx.lost - rx.tx_drops : 0, rx.tx_drops,
+            rx.late, rx.duplicates, rx.stale, s_filled);
+    return 0;
+}
@@ -0,0 +1,132 @@
+// scope_udp_tx - stand-in for the device: sends a synthetic signal using the
+// same packetizer as the firmware (main/scope_udp.c).
+//
+// Lets you exercise scope_udp_rx over localhost without hardware:
+//   ./scope_udp_rx -p 5005 -o cap.u16 &
+//   ./scope_udp_tx -r 20000 -t 5 -L 2 127.0.0.1 5005
+// -B 2 "reboots" every 2 seconds (new session, seq back to 0).
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "scope_udp.h"
+
+typedef struct {
+    int sock;
+    struct sockaddr_in to;
+    double net_loss;  // fraction silently "lost in the air"
+    double dev_drop;  // fraction reported as dropped by the sender
+    uint64_t sent;
+    uint64_t lost;
+} tx_ctx_t;
+
+static int send_dgram(const uint8_t* dgram, size_t len, void* arg) {
+    tx_ctx_t* ctx = arg;
+    double r = rand() / (double)RAND_MAX;
+
+    if (r < ctx->dev_drop) return -1;
+    if (r < ctx->dev_drop + ctx->net_loss) {
+        ctx->lost++;
+        return 0; // sender thinks it went out
+    }
+    if (sendto(ctx->sock, dgram, len, 0, (struct sockaddr*)&ctx->to, sizeof(ctx->to)) != (ssize_t)len) {
+        return -1;
+    }
+    ctx->sent++;
+    return 0;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-r rate] [-f signal_hz] [-t seconds] [-s samples_per_dgram] [-L net_loss%%] [-D dev_drop%%] [-B reboot_secs] host port\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rate = 20000;
+    double sig_hz = 100;
+    double run_secs = 5;
+    double reboot_secs = 0;
+    int per_dgram = SCOPE_UDP_MAX_SAMPLES;
+    tx_ctx_t ctx = {0};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:f:t:s:L:D:B:h")) != -1) {
+        switch (opt) {
+            case 'r': rate = (uint32_t)atoi(optarg); break;
+            case 'f': sig_hz = atof(optarg); break;
+            case 't': run_secs = atof(optarg); break;
+            case 's': per_dgram = atoi(optarg); break;
+            case 'L': ctx.net_loss = atof(optarg) / 100.0; break;
+            case 'D': ctx.dev_drop = atof(optarg) / 100.0; break;
+            case 'B': reboot_secs = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (argc - optind != 2 || rate == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    ctx.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    ctx.to.sin_family = AF_INET;
+    ctx.to.sin_port = htons(atoi(argv[optind + 1]));
+    if (ctx.sock < 0 || inet_pton(AF_INET, argv[optind], &ctx.to.sin_addr) != 1) {
+        fprintf(stderr, "bad target %s\n", argv[optind]);
+        return 2;
+    }
+
+    // Same ~20ms frames the firmware reads from the ADC (see calc_buffer_size)
+    size_t frame = rate / 50;
+    if (frame < 64) frame = 64;
+    if (frame > 2048) frame = 2048; // ADC_MAX_SAMPLES
+    uint16_t* samples = calloc(frame, sizeof(uint16_t));
+
+    scope_udp_tx_t tx;
+    srand((unsigned)time(NULL));
+    scope_udp_tx_init(&tx, rate, (uint16_t)per_dgram, (uint32_t)rand());
+    uint64_t reboot_every = (uint64_t)(reboot_secs * rate);
+
+    struct timespec start, next;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
+    uint64_t n = 0;
+    uint64_t dev_drops = 0;
+    uint64_t total = (uint64_t)(run_secs * rate);
+    long frame_ns = (long)(frame * 1e9 / rate);
+
+    while (n < total) {
+        if (reboot_every && n > 0 && n % reboot_every < frame) {
+            scope_udp_tx_init(&tx, rate, (uint16_t)per_dgram, (uint32_t)rand());
+        }
+        for (size_t i = 0; i < frame; i++, n++) {
+            double v = sin(2 * M_PI * sig_hz * n / rate);
+            samples[i] = (uint16_t)(2048 + 1800 * v);
+        }
+        uint32_t t_us = (uint32_t)((next.tv_sec - start.tv_sec) * 1000000 + (next.tv_nsec - start.tv_nsec) / 1000);
+        dev_drops += scope_udp_tx_frame(&tx, samples, frame, t_us, send_dgram, &ctx);
+
+        // Pace in real time like the ADC would
+        next.tv_nsec += frame_ns;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    fprintf(stderr, "Sent %" PRIu64 " datagrams (%" PRIu64 " samples), simulated %" PRIu64 " lost, %" PRIu64
+            " dropped on device\n", ctx.sent, n, ctx.lost, dev_drops);
+    free(samples);
+    close(ctx.sock);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "scope_ws.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -------------------------------------------------------------------------
+// SHA-1 + base64, only used for the handshake
+// -------------------------------------------------------------------------
+
+#define ROL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+static void sha1_block(uint32_t h[5], const uint8_t* p) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) | ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+        uint32_t t = ROL(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = ROL(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha1(const uint8_t* msg, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block[64];
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) sha1_block(h, msg + i);
+
+    size_t rem = len - i;
+    memset(block, 0, sizeof(block));
+    memcpy(block, msg + i, rem);
+    block[rem] = 0x80;
+    if (rem >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)len * 8;
+    for (int j = 0; j < 8; j++) block[63 - j] = (uint8_t)(bits >> (8 * j));
+    sha1_block(h, block);
+
+    for (int j = 0; j < 5; j++) {
+        out[4 * j] = h[j] >> 24;
+        out[4 * j + 1] = h[j] >> 16;
+        out[4 * j + 2] = h[j] >> 8;
+        out[4 * j + 3] = h[j];
+    }
+}
+
+static void base64(const uint8_t* in, size_t len, char* out) {
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[o++] = tbl[(v >> 18) & 63];
+        out[o++] = tbl[(v >> 12) & 63];
+        out[o++] = (i + 1 < len) ? tbl[(v >> 6) & 63] : '=';
+        out[o++] = (i + 2 < len) ? tbl[v & 63] : '=';
+    }
+    out[o] = 0;
+}
+
+void ws_accept_key(const char* key, char out[29]) {
+    char buf[128];
+    uint8_t digest[20];
+    int n = snprintf(buf, sizeof(buf), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", key);
+    sha1((const uint8_t*)buf, (size_t)n, digest);
+    base64(digest, sizeof(digest), out);
+}
+
+void ws_make_key(char out[25]) {
+    uint8_t raw[16];
+    for (int i = 0; i < 16; i++) raw[i] = (uint8_t)rand();
+    base64(raw, sizeof(raw), out);
+}
+
+// -------------------------------------------------------------------------
+// Frames
+// -------------------------------------------------------------------------
+
+int ws_parse_hdr(const uint8_t* buf, size_t len, ws_frame_hdr_t* hdr) {
+    if (len < 2) return 0;
+
+    hdr->fin = buf[0] & 0x80;
+    hdr->opcode = buf[0] & 0x0f;
+    hdr->masked = buf[1] & 0x80;
+    uint64_t plen = buf[1] & 0x7f;
+    size_t pos = 2;
+
+    if (buf[0] & 0x70) return -1; // no extensions negotiated, RSV must be 0
+
+    if (plen == 126) {
+        if (len < pos + 2) return 0;
+        plen = ((uint64_t)buf[2] << 8) | buf[3];
+        pos += 2;
+    } else if (plen == 127) {
+        if (len < pos + 8) return 0;
+        plen = 0;
+        for (int i = 0; i < 8; i++) plen = (plen << 8) | buf[2 + i];
+        pos += 8;
+    }
+    if (hdr->masked) {
+        if (len < pos + 4) return 0;
+        memcpy(hdr->mask, buf + pos, 4);
+        pos += 4;
+    }
+    hdr->len = plen;
+    return (int)pos;
+}
+
+int ws_write_hdr(uint8_t* out, uint8_t opcode, uint64_t len, const uint8_t* mask) {
+    int pos = 2;
+    out[0] = 0x80 | opcode;
+    out[1] = mask ? 0x80 : 0;
+
+    if (len < 126) {
+        out[1] |= (uint8_t)len;
+    } else if (len <= 0xffff) {
+        out[1] |= 126;
+        out[2] = (uint8_t)(len >> 8);
+        out[3] = (uint8_t)len;
+        pos = 4;
+    } else {
+        out[1] |= 127;
+        for (int i = 0; i < 8; i++) out[2 + i] = (uint8_t)(len >> (56 - 8 * i));
+        pos = 10;
+    }
+    if (mask) {
+        memcpy(out + pos, mask, 4);
+        pos += 4;
+    }
+    return pos;
+}
+
+void ws_unmask(uint8_t* buf, size_t len, const uint8_t mask[4], uint64_t offset) {
+    for (size_t i = 0; i < len; i++) buf[i] ^= mask[(offset + i) & 3];
+}
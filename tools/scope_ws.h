@@ -0,0 +1,44 @@
+#ifndef SCOPE_WS_H
+#define SCOPE_WS_H
+
+// Just enough RFC 6455 for the host tools: the upgrade handshake key and
+// frame headers. Payloads are whatever scope_codec.h says.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_OP_CONT   0x0
+#define WS_OP_TEXT   0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE  0x8
+#define WS_OP_PING   0x9
+#define WS_OP_PONG   0xA
+
+#define WS_MAX_HDR   14
+
+typedef struct {
+    bool     fin;
+    uint8_t  opcode;
+    bool     masked;
+    uint8_t  mask[4];
+    uint64_t len;
+} ws_frame_hdr_t;
+
+// Fills out[] with the Sec-WebSocket-Accept value for key (29 bytes incl. NUL)
+void ws_accept_key(const char* key, char out[29]);
+
+// Random 16-byte key, base64'd (25 bytes incl. NUL)
+void ws_make_key(char out[25]);
+
+// Returns header length, 0 if buf doesn't hold a full header yet, -1 if it's garbage
+int ws_parse_hdr(const uint8_t* buf, size_t len, ws_frame_hdr_t* hdr);
+
+// Writes a FIN frame header. mask NULL = unmasked (server->client).
+// Returns header length (<= WS_MAX_HDR).
+int ws_write_hdr(uint8_t* out, uint8_t opcode, uint64_t len, const uint8_t* mask);
+
+// XORs payload in place; offset is the position of buf[0] within the payload
+void ws_unmask(uint8_t* buf, size_t len, const uint8_t mask[4], uint64_t offset);
+
+#endif // SCOPE_WS_H
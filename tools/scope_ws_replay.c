@@ -0,0 +1,307 @@
+// scope_ws_replay - local stand-in for the device's /signal endpoint.
+//
+// Serves synthetic (or recorded) samples as binary WebSocket frames in the same
+// format, frame size and cadence (every 2nd frame) as the firmware, so scope_rec (or the browser page, see
+// the commented-out wsUrl in index.js) can be tested without hardware.
+//
+//   ./scope_ws_replay -p 8080 -r 83333 -x 20       # 20x the device's max rate
+//   ./scope_rec -r 1666660 -t 10 127.0.0.1:8080
+//
+// -i replays a raw little-endian uint16 file (e.g. from scope_udp_rx) in a loop.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include "scope_codec.h"
+#include "scope_ws.h"
+
+#define MAX_CLIENTS 32
+#define MAX_FRAME   2048 // ADC_MAX_SAMPLES in the firmware (4096 bytes at 2 bytes/sample)
+#define FRAME_EVERY 2    // the firmware's /signal throttle: every 2nd ADC frame goes out
+
+typedef struct {
+    int fd;
+    bool streaming;
+    char req[2048];
+    size_t req_len;
+    uint64_t sent;
+    uint64_t dropped;
+} client_t;
+
+static client_t s_clients[MAX_CLIENTS];
+static int s_epoll;
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    s_stop = 1;
+}
+
+static client_t* client_alloc(int fd) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (s_clients[i].fd < 0) {
+            memset(&s_clients[i], 0, sizeof(client_t));
+            s_clients[i].fd = fd;
+            return &s_clients[i];
+        }
+    }
+    return NULL;
+}
+
+static void client_close(client_t* c) {
+    if (c->streaming) {
+        fprintf(stderr, "client %d gone: %" PRIu64 " frames sent, %" PRIu64 " dropped\n", c->fd, c->sent, c->dropped);
+    }
+    epoll_ctl(s_epoll, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->streaming = false;
+}
+
+static void client_handshake(client_t* c) {
+    c->req[c->req_len] = 0;
+    if (!strstr(c->req, "\r\n\r\n")) return;
+
+    char* key = strcasestr(c->req, "Sec-WebSocket-Key:");
+    if (strncmp(c->req, "GET /signal ", 12) != 0 || !key) {
+        static const char nf[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send(c->fd, nf, sizeof(nf) - 1, MSG_NOSIGNAL);
+        client_close(c);
+        return;
+    }
+
+    key += strlen("Sec-WebSocket-Key:");
+    while (*key == ' ') key++;
+    char* eol = strstr(key, "\r\n");
+    *eol = 0;
+
+    char accept[29];
+    ws_accept_key(key, accept);
+
+    char resp[256];
+    int n = snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n"
+                     "\r\n",
+                     accept);
+    send(c->fd, resp, (size_t)n, MSG_NOSIGNAL);
+    c->streaming = true;
+    fprintf(stderr, "client %d streaming\n", c->fd);
+}
+
+static void client_readable(client_t* c) {
+    if (!c->streaming) {
+        ssize_t n = recv(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len, 0);
+        if (n <= 0 || c->req_len + n >= sizeof(c->req) - 1) {
+            client_close(c);
+            return;
+        }
+        c->req_len += (size_t)n;
+        client_handshake(c);
+        return;
+    }
+
+    // Like the firmware, we don't care what the client says. Just notice it leaving.
+    uint8_t buf[4096];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        client_close(c);
+        return;
+    }
+    ws_frame_hdr_t fh;
+    if (n > 0 && ws_parse_hdr(buf, (size_t)n, &fh) > 0 && fh.opcode == WS_OP_CLOSE) client_close(c);
+}
+
+// One frame to every streaming client. A full socket buffer means the frame is
+// dropped for that client, same as httpd_ws_send_frame_async failing on the device.
+static void broadcast(const uint8_t* frame, size_t len) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t* c = &s_clients[i];
+        if (c->fd < 0 || !c->streaming) continue;
+
+        ssize_t n = send(c->fd, frame, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == (ssize_t)len) {
+            c->sent++;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            c->dropped++;
+        } else {
+            // Partial write or error: the stream is now out of sync, drop the client
+            client_close(c);
+        }
+    }
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-p port] [-r rate] [-f signal_hz] [-x speedup] [-i file.u16]\n"
+            "  -p  TCP port (default 8080)\n"
+            "  -r  sample rate the frames pretend to have (default 20000)\n"
+            "  -f  test signal frequency (default 100)\n"
+            "  -x  send this many times faster than real time (default 1)\n"
+            "  -i  replay raw little-endian uint16 samples from a file instead\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    uint32_t rate = 20000;
+    double sig_hz = 100;
+    double speedup = 1;
+    const char* in_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:r:f:x:i:h")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'r': rate = (uint32_t)atoi(optarg); break;
+            case 'f': sig_hz = atof(optarg); break;
+            case 'x': speedup = atof(optarg); break;
+            case 'i': in_path = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (rate == 0 || speedup <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Source samples
+    uint16_t* src = NULL;
+    size_t src_len = 0;
+    if (in_path) {
+        FILE* f = fopen(in_path, "rb");
+        if (!f) {
+            perror(in_path);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        long bytes = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        src_len = (size_t)bytes / SCOPE_CODEC_BYTES_PER_SAMPLE;
+        uint8_t* raw = malloc((size_t)bytes);
+        src = malloc(src_len * sizeof(uint16_t));
+        if (!raw || !src || fread(raw, 1, (size_t)bytes, f) != (size_t)bytes || src_len == 0) {
+            fprintf(stderr, "can't read %s\n", in_path);
+            return 1;
+        }
+        scope_codec_decode(src, raw, src_len);
+        free(raw);
+        fclose(f);
+    } else {
+        // One second of a sine with a bit of noise, looped
+        src_len = rate;
+        src = malloc(src_len * sizeof(uint16_t));
+        for (size_t i = 0; i < src_len; i++) {
+            double v = 2048 + 1800 * sin(2 * M_PI * sig_hz * i / rate) + (rand() % 17) - 8;
+            src[i] = (uint16_t)v;
+        }
+    }
+
+    // Same frame size as calc_buffer_size() in the firmware: ~20ms of samples
+    size_t frame_samples = rate / 50;
+    if (frame_samples < 64) frame_samples = 64; // 128 bytes
+    if (frame_samples > MAX_FRAME) frame_samples = MAX_FRAME;
+    long period_ns = (long)(frame_samples * 1e9 / rate / speedup);
+    if (period_ns < 1000) period_ns = 1000;
+
+    int lsock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if (bind(lsock, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lsock, 8) < 0) {
+        perror("bind/listen");
+        return 1;
+    }
+
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct itimerspec its = {
+        .it_interval = { period_ns / 1000000000, period_ns % 1000000000 },
+        .it_value = { period_ns / 1000000000, period_ns % 1000000000 },
+    };
+    timerfd_settime(tfd, 0, &its, NULL);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) s_clients[i].fd = -1;
+
+    s_epoll = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(s_epoll, EPOLL_CTL_ADD, lsock, &ev);
+    ev.data.ptr = &tfd;
+    epoll_ctl(s_epoll, EPOLL_CTL_ADD, tfd, &ev);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Serving ws://0.0.0.0:%d/signal, %zu samples/frame every %.3f ms (%.0f sps sent)\n",
+            port, frame_samples, period_ns * FRAME_EVERY / 1e6, frame_samples * 1e9 / period_ns / FRAME_EVERY);
+
+    static uint8_t frame[WS_MAX_HDR + MAX_FRAME * SCOPE_CODEC_BYTES_PER_SAMPLE];
+    uint16_t samples[MAX_FRAME];
+    size_t src_pos = 0;
+    unsigned skip = 0;
+
+    while (!s_stop) {
+        struct epoll_event events[MAX_CLIENTS + 2];
+        int n = epoll_wait(s_epoll, events, MAX_CLIENTS + 2, 500);
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                int cfd = accept4(lsock, NULL, NULL, SOCK_NONBLOCK);
+                if (cfd < 0) continue;
+                client_t* c = client_alloc(cfd);
+                if (!c) {
+                    close(cfd);
+                    continue;
+                }
+                struct epoll_event cev = { .events = EPOLLIN, .data.ptr = c };
+                epoll_ctl(s_epoll, EPOLL_CTL_ADD, cfd, &cev);
+            } else if (events[i].data.ptr == &tfd) {
+                uint64_t ticks = 0;
+                if (read(tfd, &ticks, sizeof(ticks)) != sizeof(ticks)) continue;
+
+                // If we fell behind, catch up rather than slowly drifting
+                for (uint64_t t = 0; t < ticks; t++) {
+                    for (size_t k = 0; k < frame_samples; k++) {
+                        samples[k] = src[src_pos];
+                        if (++src_pos == src_len) src_pos = 0;
+                    }
+                    // The skipped frame still moves the signal on, like the ADC does
+                    if (++skip < FRAME_EVERY) continue;
+                    skip = 0;
+                    size_t plen = scope_codec_len(frame_samples);
+                    int h = ws_write_hdr(frame, WS_OP_BINARY, plen, NULL);
+                    scope_codec_encode(frame + h, samples, frame_samples);
+                    broadcast(frame, (size_t)h + plen);
+                }
+            } else {
+                client_readable(events[i].data.ptr);
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (s_clients[i].fd >= 0) client_close(&s_clients[i]);
+    }
+    close(tfd);
+    close(lsock);
+    free(src);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// test_capture - host test for the scope_rec capture file: appends frames,
+// checks the chunks can be walked through data_end both while recording (as
+// after a crash) and after scap_close, and that the index agrees.
+//
+//   make -C tools test
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "scope_capture.h"
+#include "scope_codec.h"
+#include "test_util.h"
+
+typedef struct {
+    size_t n;
+    uint64_t t_us;
+    uint64_t first_sample;
+    uint16_t seed;
+} frame_t;
+
+#define MAX_FRAMES 1200
+
+static frame_t s_frames[MAX_FRAMES];
+static int s_num_frames;
+static uint64_t s_total;
+
+static void fill(uint16_t* s, size_t n, uint16_t seed) {
+    for (size_t i = 0; i < n; i++) s[i] = (uint16_t)((seed + i * 13) & SCOPE_CODEC_MAX_CODE);
+}
+
+static bool append(scap_writer_t* w, size_t n, uint64_t t_us) {
+    static uint16_t samples[1 << 16];
+    static uint8_t payload[1 << 17];
+    frame_t* f = &s_frames[s_num_frames++];
+    *f = (frame_t){ n, t_us, s_total, (uint16_t)rand() };
+    fill(samples, n, f->seed);
+    scope_codec_encode(payload, samples, n);
+    s_total += n;
+    return scap_append(w, payload, n, t_us);
+}
+
+static uint8_t* read_file(const char* path, size_t* len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) return NULL;
+    uint8_t* buf = malloc((size_t)st.st_size);
+    size_t got = 0;
+    while (got < (size_t)st.st_size) {
+        ssize_t r = read(fd, buf + got, (size_t)st.st_size - got);
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    *len = got;
+    return buf;
+}
+
+static uint32_t get_u32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t get_u64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+// Walks the chunks from the header to data_end, the way a reader would after a
+// crash. Returns the number of chunks, -1 if one doesn't match what went in.
+static int walk(const uint8_t* file, size_t len) {
+    static uint16_t got[1 << 16], exp[1 << 16];
+    const scap_hdr_t* h = (const scap_hdr_t*)file;
+    if (h->data_end > len) return -1;
+
+    uint64_t pos = h->hdr_len;
+    int i = 0;
+    while (pos < h->data_end) {
+        const uint8_t* p = file + pos;
+        if (pos % 8 || i >= s_num_frames || get_u32(p) != SCAP_CHUNK_MAGIC) return -1;
+
+        const frame_t* f = &s_frames[i];
+        size_t n = get_u32(p + 4);
+        if (n != f->n || get_u64(p + 8) != (uint64_t)i || get_u64(p + 16) != f->t_us ||
+            get_u64(p + 24) != f->first_sample) {
+            fprintf(stderr, "chunk %d: count %zu seq %llu t_us %llu first %llu\n", i, n,
+                    (unsigned long long)get_u64(p + 8), (unsigned long long)get_u64(p + 16),
+                    (unsigned long long)get_u64(p + 24));
+            return -1;
+        }
+        scope_codec_decode(got, p + SCAP_CHUNK_HDR, n);
+        fill(exp, n, f->seed);
+        if (memcmp(got, exp, n * sizeof(uint16_t)) != 0) return -1;
+
+        size_t body = SCAP_CHUNK_HDR + scope_codec_len(n);
+        size_t total = (body + 7) & ~(size_t)7;
+        for (size_t k = body; k < total; k++) {
+            if (p[k] != 0) return -1; // padding
+        }
+        pos += total;
+        i++;
+    }
+    return pos == h->data_end ? i : -1;
+}
+
+static void test_record(const char* path) {
+    scap_writer_t w;
+    s_num_frames = 0;
+    s_total = 0;
+    CHECK(scap_open(&w, path, "esp-scope.local:80", 83333));
+
+    // Odd counts so the 8-byte padding gets exercised, and an empty frame
+    uint64_t t = 1000;
+    static const size_t sizes[] = { 1668, 1, 2, 3, 4, 0, 722, 2048, 1667 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CHECK(append(&w, sizes[i], t));
+        t += 20000;
+    }
+
+    // Killed mid-recording: no index, but everything up to data_end is there
+    size_t len;
+    uint8_t* file = read_file(path, &len);
+    CHECK(file != NULL);
+    if (file) {
+        const scap_hdr_t* h = (const scap_hdr_t*)file;
+        CHECK(memcmp(h->magic, SCAP_MAGIC, 8) == 0 && h->version == SCAP_VERSION && h->hdr_len == SCAP_HDR_LEN);
+        CHECK(h->sample_rate == 83333 && strcmp(h->source, "esp-scope.local:80") == 0);
+        CHECK(h->index_offset == 0 && h->index_count == 0);
+        CHECK(walk(file, len) == s_num_frames);
+        free(file);
+    }
+
+    // Big frames until the map has to grow past the first 64MB
+    while (s_total * 2 < 80u * 1024 * 1024 && s_num_frames < MAX_FRAMES) {
+        CHECK(append(&w, 65000 + rand() % 536, t));
+        t += 20000;
+    }
+    scap_close(&w);
+
+    file = read_file(path, &len);
+    CHECK(file != NULL);
+    if (!file) return;
+    const scap_hdr_t* h = (const scap_hdr_t*)file;
+    CHECK(walk(file, len) == s_num_frames);
+
+    // The index follows the last chunk and the file ends right after it
+    CHECK(h->index_offset == h->data_end && h->index_count == (uint64_t)s_num_frames);
+    CHECK(len == h->index_offset + h->index_count * sizeof(scap_index_t));
+    uint64_t pos = h->hdr_len;
+    for (int i = 0; i < s_num_frames && h->index_offset + (i + 1) * sizeof(scap_index_t) <= len; i++) {
+        scap_index_t e;
+        memcpy(&e, file + h->index_offset + i * sizeof(scap_index_t), sizeof(e));
+        if (e.offset != pos || e.t_us != s_frames[i].t_us || e.first_sample != s_frames[i].first_sample) {
+            fprintf(stderr, "index %d: offset %llu t_us %llu first %llu\n", i, (unsigned long long)e.offset,
+                    (unsigned long long)e.t_us, (unsigned long long)e.first_sample);
+            s_failures++;
+            break;
+        }
+        pos += (SCAP_CHUNK_HDR + scope_codec_len(s_frames[i].n) + 7) & ~(size_t)7;
+    }
+    printf("  %d chunks, %llu samples, %zu bytes\n", s_num_frames, (unsigned long long)s_total, len);
+    free(file);
+}
+
+static void test_discard(const char* path) {
+    scap_writer_t w;
+    CHECK(scap_open(&w, path, "x", 20000));
+    scap_discard(&w);
+    CHECK(access(path, F_OK) != 0);
+}
+
+int main(void) {
+    srand(1);
+    char dir[] = "/tmp/test_capture_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "%s/cap.scap", dir);
+
+    test_record(path);
+    unlink(path);
+    test_discard(path);
+    rmdir(dir);
+    return test_result("test_capture");
+}
@@ -0,0 +1,278 @@
+// test_decode - host test for the UART decoder in scope_decode: synthesizes
+// lines (5..9 data bits, none/even/odd parity, 1 or 2 stop bits) at a range of
+// baud rates, sample rates and noise levels, feeds them in random frame sizes
+// and checks the decoded characters, flags and times.
+//
+//   make -C tools test
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scope_decode.h"
+#include "test_util.h"
+
+#define N_CHARS   200
+#define LEVEL_LO  500
+#define LEVEL_HI  3500
+#define THR_LO    1500
+#define THR_HI    2500
+
+// Character format, i.e. the "8N1" part
+typedef struct {
+    uint8_t bits;
+    scope_parity_t parity;
+    uint8_t stop;
+} format_t;
+
+static const char* format_name(const format_t* f) {
+    static char name[16];
+    snprintf(name, sizeof(name), "%u%c%u", f->bits, "NEO"[f->parity], f->stop);
+    return name;
+}
+
+typedef struct {
+    uint16_t data;
+    uint8_t flags;     // what the decoder should report
+    uint32_t t;        // first sample at or after the start edge
+} expect_t;
+
+// A line as a list of level changes, in bit times from t = 0
+typedef struct {
+    double* at;
+    uint8_t* level;
+    int n, cap;
+} line_t;
+
+static void line_set(line_t* l, double at, uint8_t level) {
+    if (l->n == l->cap) {
+        l->cap = l->cap ? 2 * l->cap : 1024;
+        l->at = realloc(l->at, l->cap * sizeof(double));
+        l->level = realloc(l->level, l->cap);
+    }
+    l->at[l->n] = at;
+    l->level[l->n] = level;
+    l->n++;
+}
+
+typedef enum {
+    CHAR_OK,
+    CHAR_BAD_PARITY,
+    CHAR_BAD_STOP,   // first stop bit low
+    CHAR_BAD_STOP2,  // first stop bit fine, second one low (2 stop bits only)
+    CHAR_BREAK,
+} char_kind_t;
+
+// Appends one character starting at bit time *t, returns the bit time of its
+// start edge. Leaves the line idle (high) afterwards.
+static double put_char(line_t* l, double* t, uint16_t data, const format_t* f, char_kind_t kind) {
+    const double start = *t;
+    uint8_t bits[13];
+    int n = 0;
+
+    bits[n++] = 0;
+    int ones = 0;
+    for (int i = 0; i < f->bits; i++) {
+        uint8_t b = kind == CHAR_BREAK ? 0 : (data >> i) & 1;
+        bits[n++] = b;
+        ones += b;
+    }
+    if (f->parity != SCOPE_PARITY_NONE) {
+        uint8_t p = (f->parity == SCOPE_PARITY_EVEN) ? (ones & 1) : !(ones & 1);
+        if (kind == CHAR_BAD_PARITY) p ^= 1;
+        if (kind == CHAR_BREAK) p = 0;
+        bits[n++] = p;
+    }
+    for (int i = 0; i < f->stop; i++) {
+        bool low = kind == CHAR_BREAK || (kind == CHAR_BAD_STOP && i == 0) || (kind == CHAR_BAD_STOP2 && i == 1);
+        bits[n++] = !low;
+    }
+
+    for (int i = 0; i < n; i++) line_set(l, start + i, bits[i]);
+    *t = start + n;
+    if (kind == CHAR_BREAK) *t += 3; // hold it low for a while, like a real break
+    line_set(l, *t, 1);
+    return start;
+}
+
+static uint16_t* render(const line_t* l, double samples_per_bit, size_t n, int noise, bool invert) {
+    uint16_t* s = malloc(n * sizeof(uint16_t));
+    int e = 0;
+    uint8_t level = 1;
+    for (size_t i = 0; i < n; i++) {
+        double t = i / samples_per_bit;
+        while (e < l->n && l->at[e] <= t) level = l->level[e++];
+        int v = (level ^ invert) ? LEVEL_HI : LEVEL_LO;
+        if (noise) v += rand() % (2 * noise + 1) - noise;
+        s[i] = (uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v)); // it's still a 12-bit ADC
+    }
+    return s;
+}
+
+// Feeds in random frame sizes, collecting events as the firmware would (take
+// them after every frame). Returns the number of events.
+static int run(scope_decoder_t* d, const uint16_t* s, size_t n, scope_decode_event_t* out, int max) {
+    static uint8_t frame[SCOPE_DECODE_HDR_LEN + SCOPE_DECODE_MAX_EVENTS * SCOPE_DECODE_EVENT_LEN];
+    int got = 0;
+
+    for (size_t pos = 0; pos < n;) {
+        size_t len = 1 + rand() % 1000;
+        if (len > n - pos) len = n - pos;
+        scope_decode_feed(d, s + pos, len);
+        pos += len;
+
+        size_t flen = scope_decode_take_events(d, frame, sizeof(frame));
+        if (flen == 0) continue;
+
+        // Go through the wire format, that's what the page gets
+        CHECK((frame[0] | frame[1] << 8) == SCOPE_DECODE_MAGIC);
+        int count = frame[2] | frame[3] << 8;
+        CHECK(flen == (size_t)(SCOPE_DECODE_HDR_LEN + count * SCOPE_DECODE_EVENT_LEN));
+        for (int i = 0; i < count && got < max; i++) {
+            const uint8_t* p = frame + SCOPE_DECODE_HDR_LEN + i * SCOPE_DECODE_EVENT_LEN;
+            out[got].t = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+            out[got].data = p[4] | p[5] << 8;
+            out[got].flags = p[6];
+            out[got].proto = p[7];
+            got++;
+        }
+    }
+    return got;
+}
+
+static void check_line(uint32_t fs, uint32_t baud, const format_t* fmt, int noise, bool invert, bool errors) {
+    const double spb = (double)fs / baud;
+    line_t l = { 0 };
+    expect_t exp[N_CHARS];
+
+    double t = 2.5; // idle first
+    for (int c = 0; c < N_CHARS; c++) {
+        char_kind_t kind = CHAR_OK;
+        if (errors && c % 10 == 9) {
+            static const char_kind_t bad[] = { CHAR_BAD_PARITY, CHAR_BAD_STOP, CHAR_BAD_STOP2, CHAR_BREAK };
+            kind = bad[(c / 10) % 4];
+            if (kind == CHAR_BAD_PARITY && fmt->parity == SCOPE_PARITY_NONE) kind = CHAR_BAD_STOP;
+            if (kind == CHAR_BAD_STOP2 && fmt->stop == 1) kind = CHAR_BAD_STOP;
+        }
+        uint16_t data = (uint16_t)(rand() & ((1 << fmt->bits) - 1));
+        // A framing error with all zero data (and parity) would be a break
+        if ((kind == CHAR_BAD_STOP || kind == CHAR_BAD_STOP2) && data == 0) data = 0x15;
+
+        double start = put_char(&l, &t, data, fmt, kind);
+        exp[c].t = (uint32_t)ceil(start * spb);
+        switch (kind) {
+            case CHAR_OK: exp[c].data = data; exp[c].flags = 0; break;
+            case CHAR_BAD_PARITY: exp[c].data = data; exp[c].flags = SCOPE_DECODE_ERR_PARITY; break;
+            case CHAR_BAD_STOP:
+            case CHAR_BAD_STOP2: exp[c].data = data; exp[c].flags = SCOPE_DECODE_ERR_FRAMING; break;
+            case CHAR_BREAK:
+                exp[c].data = 0;
+                exp[c].flags = SCOPE_DECODE_ERR_FRAMING | SCOPE_DECODE_BREAK;
+                // All zero, parity bit included, is a parity error too with odd parity
+                if (fmt->parity == SCOPE_PARITY_ODD) exp[c].flags |= SCOPE_DECODE_ERR_PARITY;
+                break;
+        }
+
+        // Back-to-back most of the time, sometimes a gap of a few bits (not whole ones).
+        // After a bad stop bit the line has to go idle before the decoder can
+        // find the next start edge, same as a real UART.
+        if (kind == CHAR_BAD_STOP || kind == CHAR_BAD_STOP2 || kind == CHAR_BREAK) t += 1;
+        if (rand() % 3 == 0) t += (rand() % 300) / 100.0;
+    }
+    t += 2;
+
+    size_t n = (size_t)ceil(t * spb);
+    uint16_t* s = render(&l, spb, n, noise, invert);
+
+    scope_decode_cfg_t cfg = {
+        .proto = SCOPE_DECODE_UART,
+        .thr_lo = THR_LO,
+        .thr_hi = THR_HI,
+        .invert = invert,
+        .baud = baud,
+        .data_bits = fmt->bits,
+        .parity = fmt->parity,
+        .stop_bits = fmt->stop,
+    };
+    scope_decoder_t* d = malloc(sizeof(*d));
+    scope_decode_init(d);
+    CHECK(scope_decode_config(d, &cfg, fs));
+
+    static scope_decode_event_t ev[N_CHARS + 16];
+    int got = run(d, s, n, ev, N_CHARS + 16);
+
+    int bad = 0;
+    if (got != N_CHARS) {
+        fprintf(stderr, "%u Hz %u baud %s noise %d%s: %d events, expected %d\n", (unsigned)fs, (unsigned)baud,
+                format_name(fmt), noise, invert ? " inverted" : "", got, N_CHARS);
+        bad++;
+    }
+    for (int i = 0; i < got && i < N_CHARS && bad < 5; i++) {
+        // Noise can move the threshold crossing by a sample either way
+        int dt = (int)(ev[i].t - exp[i].t);
+        if (ev[i].data != exp[i].data || ev[i].flags != exp[i].flags || ev[i].proto != SCOPE_DECODE_UART ||
+            dt < -1 || dt > 1) {
+            fprintf(stderr, "%u Hz %u baud %s noise %d%s: char %d got %03x flags %02x t %u, expected %03x flags %02x t %u\n",
+                    (unsigned)fs, (unsigned)baud, format_name(fmt), noise,
+                    invert ? " inverted" : "", i, ev[i].data, ev[i].flags, (unsigned)ev[i].t, exp[i].data,
+                    exp[i].flags, (unsigned)exp[i].t);
+            bad++;
+        }
+    }
+    s_failures += bad;
+
+    free(d);
+    free(s);
+    free(l.at);
+    free(l.level);
+}
+
+int main(void) {
+    srand(1);
+
+    static const uint32_t rates[] = { 20000, 50000, 83333 };
+    static const uint32_t bauds[] = { 1200, 2400, 4800, 9600, 14400, 19200, 27777 };
+    static const int noises[] = { 0, 300, 900 }; // 900 still stays inside the hysteresis margins
+    static const format_t k_8n1 = { 8, SCOPE_PARITY_NONE, 1 }, k_8e1 = { 8, SCOPE_PARITY_EVEN, 1 };
+    // Everything else the decoder takes: short and 9-bit characters, odd parity, 2 stop bits
+    static const format_t formats[] = {
+        { 5, SCOPE_PARITY_NONE, 1 }, { 6, SCOPE_PARITY_ODD, 1 }, { 7, SCOPE_PARITY_EVEN, 2 },
+        { 8, SCOPE_PARITY_ODD, 1 }, { 8, SCOPE_PARITY_NONE, 2 }, { 8, SCOPE_PARITY_ODD, 2 },
+        { 9, SCOPE_PARITY_NONE, 1 }, { 9, SCOPE_PARITY_EVEN, 1 }, { 9, SCOPE_PARITY_ODD, 2 },
+    };
+    int combos = 0;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (size_t b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++) {
+            scope_decode_cfg_t cfg = {
+                .proto = SCOPE_DECODE_UART, .thr_lo = THR_LO, .thr_hi = THR_HI,
+                .baud = bauds[b], .data_bits = 8, .stop_bits = 1,
+            };
+            bool ok = rates[r] / bauds[b] >= SCOPE_DECODE_MIN_SAMPLES_PER_BIT;
+            CHECK(scope_decode_check(&cfg, rates[r]) == ok);
+            if (!ok) continue;
+
+            for (size_t k = 0; k < sizeof(noises) / sizeof(noises[0]); k++) {
+                check_line(rates[r], bauds[b], &k_8n1, noises[k], false, false);
+                check_line(rates[r], bauds[b], &k_8e1, noises[k], false, false);
+                combos += 2;
+            }
+            // Parity/framing errors and breaks, and an idle-low line
+            check_line(rates[r], bauds[b], &k_8e1, 300, false, true);
+            check_line(rates[r], bauds[b], &k_8n1, 300, false, true);
+            check_line(rates[r], bauds[b], &k_8e1, 300, true, false);
+            combos += 3;
+
+            // Other formats, clean and with errors (incl. a low 2nd stop bit)
+            for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+                check_line(rates[r], bauds[b], &formats[f], 300, false, false);
+                check_line(rates[r], bauds[b], &formats[f], 300, false, true);
+                combos += 2;
+            }
+        }
+    }
+    printf("test_decode: %d line configs\n", combos);
+
+    return test_result("test_decode");
+}
@@ -0,0 +1,177 @@
+// test_filter - host test for scope_filter: each stage type, fed in random
+// frame sizes, against a double-precision reference (RBJ biquad with
+// unquantized coefficients, plain moving average).
+//
+//   make -C tools test
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scope_filter.h"
+#include "test_util.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define N_SAMPLES 200000 // > 2s at the top rate, long enough for a Q=30 notch to settle
+#define MAX_ERR_LSB 3
+
+static uint16_t s_in[N_SAMPLES];
+static uint16_t s_out[N_SAMPLES];
+static uint16_t s_whole[N_SAMPLES];
+static double s_ref[N_SAMPLES];
+
+// Mains hum + a tone + noise around mid scale, with a step in the middle so
+// the high-pass and notch get a transient too. Stays clear of the rails.
+static void make_input(uint32_t fs) {
+    for (int i = 0; i < N_SAMPLES; i++) {
+        double t = (double)i / fs;
+        double v = 2048 + 500 * sin(2 * M_PI * 50 * t) + 250 * sin(2 * M_PI * 1234 * t);
+        v += (rand() % 201) - 100;
+        if (i >= N_SAMPLES / 2) v += 300;
+        s_in[i] = (uint16_t)lround(v);
+    }
+}
+
+// Reference biquad: the cookbook formulas again, run in double (DF1)
+static void ref_biquad(const scope_filter_cfg_t* cfg, uint32_t fs, double* x, int n) {
+    double q = cfg->q > 0 ? cfg->q : M_SQRT1_2;
+    double w0 = 2 * M_PI * cfg->freq_hz / fs;
+    double cw = cos(w0), alpha = sin(w0) / (2 * q);
+    double b0, b1, b2;
+
+    if (cfg->type == SCOPE_FILTER_LOWPASS) {
+        b0 = (1 - cw) / 2; b1 = 1 - cw; b2 = (1 - cw) / 2;
+    } else if (cfg->type == SCOPE_FILTER_HIGHPASS) {
+        b0 = (1 + cw) / 2; b1 = -(1 + cw); b2 = (1 + cw) / 2;
+    } else {
+        b0 = 1; b1 = -2 * cw; b2 = 1;
+    }
+    double a0 = 1 + alpha, a1 = -2 * cw, a2 = 1 - alpha;
+    b0 /= a0; b1 /= a0; b2 /= a0; a1 /= a0; a2 /= a0;
+
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    for (int i = 0; i < n; i++) {
+        double y = b0 * x[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1; x1 = x[i];
+        y2 = y1; y1 = y;
+        x[i] = y;
+    }
+}
+
+// Reference moving average: the window starts out full of mid-scale (0)
+static void ref_avg(int taps, double* x, int n) {
+    double* in = malloc(n * sizeof(double));
+    memcpy(in, x, n * sizeof(double));
+    for (int i = 0; i < n; i++) {
+        double sum = 0;
+        for (int k = 0; k < taps && k <= i; k++) sum += in[i - k];
+        x[i] = sum / taps;
+    }
+    free(in);
+}
+
+static void ref_chain(const scope_filter_cfg_t* cfg, int n_stages, uint32_t fs) {
+    for (int i = 0; i < N_SAMPLES; i++) s_ref[i] = (double)s_in[i] - 2048;
+    for (int s = 0; s < n_stages; s++) {
+        if (cfg[s].type == SCOPE_FILTER_MOVING_AVG) {
+            ref_avg(cfg[s].taps, s_ref, N_SAMPLES);
+        } else {
+            ref_biquad(&cfg[s], fs, s_ref, N_SAMPLES);
+        }
+    }
+    for (int i = 0; i < N_SAMPLES; i++) {
+        double v = s_ref[i] + 2048;
+        s_ref[i] = v < 0 ? 0 : (v > 4095 ? 4095 : v);
+    }
+}
+
+static void check_chain(const char* name, const scope_filter_cfg_t* cfg, int n_stages, uint32_t fs) {
+    make_input(fs);
+    ref_chain(cfg, n_stages, fs);
+
+    scope_filter_chain_t chain;
+    scope_filter_chain_init(&chain);
+    CHECK(scope_filter_chain_set(&chain, cfg, n_stages, fs));
+
+    // Random frame sizes, including odd ones and ones across the internal block size
+    memcpy(s_out, s_in, sizeof(s_out));
+    for (int pos = 0; pos < N_SAMPLES;) {
+        int len = 1 + rand() % 1000;
+        if (len > N_SAMPLES - pos) len = N_SAMPLES - pos;
+        scope_filter_chain_process(&chain, s_out + pos, len);
+        pos += len;
+    }
+
+    // Splitting must not change a thing: same as one call over everything
+    scope_filter_chain_reset(&chain);
+    memcpy(s_whole, s_in, sizeof(s_whole));
+    scope_filter_chain_process(&chain, s_whole, N_SAMPLES);
+    CHECK(memcmp(s_out, s_whole, sizeof(s_out)) == 0);
+
+    double max_err = 0;
+    int worst = 0;
+    for (int i = 0; i < N_SAMPLES; i++) {
+        double err = fabs(s_out[i] - s_ref[i]);
+        if (err > max_err) {
+            max_err = err;
+            worst = i;
+        }
+    }
+    printf("  %-22s %6u Hz  max err %.2f LSB (at %d)\n", name, (unsigned)fs, max_err, worst);
+    if (max_err > MAX_ERR_LSB) {
+        fprintf(stderr, "%s at %u Hz: %.2f LSB off the reference at sample %d (limit %d)\n",
+                name, (unsigned)fs, max_err, worst, MAX_ERR_LSB);
+        s_failures++;
+    }
+}
+
+int main(void) {
+    srand(1);
+
+    static const uint32_t rates[] = { 20000, 50000, 83333 };
+    const scope_filter_cfg_t lp1k = { SCOPE_FILTER_LOWPASS, 1000, 0, 0 };
+    const scope_filter_cfg_t lp_sharp = { SCOPE_FILTER_LOWPASS, 200, 2, 0 };
+    const scope_filter_cfg_t hp = { SCOPE_FILTER_HIGHPASS, 100, 0, 0 };
+    const scope_filter_cfg_t notch50 = { SCOPE_FILTER_NOTCH, 50, 10, 0 };
+    const scope_filter_cfg_t notch60 = { SCOPE_FILTER_NOTCH, 60, 10, 0 };
+    const scope_filter_cfg_t notch_q30 = { SCOPE_FILTER_NOTCH, 50, 30, 0 };
+    const scope_filter_cfg_t avg8 = { SCOPE_FILTER_MOVING_AVG, 0, 0, 8 };
+    const scope_filter_cfg_t avg_max = { SCOPE_FILTER_MOVING_AVG, 0, 0, SCOPE_FILTER_MAX_TAPS };
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        const uint32_t fs = rates[r];
+        check_chain("lowpass 1k", &lp1k, 1, fs);
+        check_chain("lowpass 200 Q2", &lp_sharp, 1, fs);
+        check_chain("highpass 100", &hp, 1, fs);
+        check_chain("notch 50 Q10", &notch50, 1, fs);
+        check_chain("notch 60 Q10", &notch60, 1, fs);
+        check_chain("notch 50 Q30", &notch_q30, 1, fs);
+        check_chain("avg 8", &avg8, 1, fs);
+        check_chain("avg 64", &avg_max, 1, fs);
+
+        const scope_filter_cfg_t chain[] = { notch50, hp, lp1k, avg8 };
+        check_chain("notch+hp+lp+avg", chain, 4, fs);
+    }
+
+    // Bad configs are refused and leave the chain alone
+    scope_filter_chain_t chain;
+    scope_filter_chain_init(&chain);
+    CHECK(scope_filter_chain_set(&chain, &lp1k, 1, 20000));
+    const scope_filter_cfg_t too_high = { SCOPE_FILTER_LOWPASS, 10000, 0, 0 };
+    const scope_filter_cfg_t too_many_taps = { SCOPE_FILTER_MOVING_AVG, 0, 0, SCOPE_FILTER_MAX_TAPS + 1 };
+    CHECK(!scope_filter_chain_set(&chain, &too_high, 1, 20000));
+    CHECK(!scope_filter_chain_set(&chain, &too_many_taps, 1, 20000));
+    CHECK(chain.num_stages == 1 && chain.stage[0].type == SCOPE_FILTER_LOWPASS);
+
+    // A rate change that puts a stage past Nyquist drops the chain
+    const scope_filter_cfg_t lp9k = { SCOPE_FILTER_LOWPASS, 9000, 0, 0 };
+    CHECK(scope_filter_chain_set(&chain, &lp9k, 1, 83333));
+    CHECK(!scope_filter_chain_set_rate(&chain, 10000));
+    CHECK(!scope_filter_chain_active(&chain));
+
+    return test_result("test_filter");
+}
@@ -0,0 +1,249 @@
+// test_mask - host test for scope_mask: random frame sizes against a
+// brute-force reference that walks the whole stream one sample at a time and
+// cuts out the waveforms the mask test should see.
+//
+//   make -C tools test
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scope_codec.h"
+#include "scope_mask.h"
+#include "test_util.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define N_SAMPLES 100000
+
+static uint16_t s_in[N_SAMPLES];
+static scope_mask_t s_mask;
+static scope_mask_cfg_t s_cfg;
+
+// Reference results
+typedef struct {
+    uint32_t tested, passed, failed;
+    int num_captures;
+    scope_mask_capture_t captures[SCOPE_MASK_MAX_CAPTURES];
+} ref_t;
+
+static ref_t s_ref;
+
+// Sine with a little noise, and now and then a glitch to one of the rails
+static void make_input(int period) {
+    for (int i = 0; i < N_SAMPLES; i++) {
+        int v = 2048 + (int)lround(1000 * sin(2 * M_PI * i / period)) + rand() % 41 - 20;
+        if (rand() % 5000 == 0) v = (rand() & 1) ? SCOPE_CODEC_MAX_CODE : 0;
+        s_in[i] = (uint16_t)v;
+    }
+}
+
+static void ref_wave(const uint16_t* lo, const uint16_t* hi, uint32_t start, uint16_t len) {
+    const uint16_t* w = s_in + start;
+    int viol = 0, first = -1;
+    for (int i = 0; i < len; i++) {
+        if (w[i] < lo[i] || w[i] > hi[i]) {
+            viol++;
+            if (first < 0) first = i;
+        }
+    }
+    s_ref.tested++;
+    if (viol == 0) {
+        s_ref.passed++;
+        return;
+    }
+    s_ref.failed++;
+    if (s_ref.num_captures < SCOPE_MASK_MAX_CAPTURES) {
+        scope_mask_capture_t* c = &s_ref.captures[s_ref.num_captures++];
+        c->t = start;
+        c->first_fail = (uint16_t)first;
+        c->violations = (uint16_t)viol;
+        memcpy(c->samples, w, len * sizeof(uint16_t));
+    }
+}
+
+// One sample at a time, straight from the description in scope_mask.h
+static void ref_run(const scope_mask_cfg_t* cfg) {
+    static uint16_t lo[SCOPE_MASK_MAX_LEN], hi[SCOPE_MASK_MAX_LEN];
+    memset(&s_ref, 0, sizeof(s_ref));
+    memcpy(lo, cfg->lo, sizeof(lo));
+    memcpy(hi, cfg->hi, sizeof(hi));
+
+    const int len = cfg->len;
+    const int pre = cfg->trigger == SCOPE_MASK_TRIG_NONE ? 0 : cfg->pre;
+    const int level = cfg->level, hyst = cfg->hyst ? cfg->hyst : 1;
+    bool teach = cfg->mode == SCOPE_MASK_TEACH;
+    bool armed = false;
+    long wave_end = -1; // exclusive, -1 = not in a waveform
+
+    for (long i = 0; i < N_SAMPLES; i++) {
+        if (wave_end < 0) {
+            int s = s_in[i];
+            bool hit = false;
+            if (cfg->trigger == SCOPE_MASK_TRIG_NONE) {
+                hit = true;
+            } else if (cfg->trigger == SCOPE_MASK_TRIG_RISING) {
+                if (armed && s >= level) hit = true;
+                else if (s <= level - hyst) armed = true;
+            } else {
+                if (armed && s <= level) hit = true;
+                else if (s >= level + hyst) armed = true;
+            }
+            if (hit) {
+                armed = false;
+                // A trigger too early for its pre-trigger samples is skipped
+                if (i >= pre) wave_end = i - pre + len;
+            }
+        }
+
+        if (wave_end >= 0 && i + 1 == wave_end) {
+            uint32_t start = (uint32_t)(wave_end - len);
+            if (teach) {
+                for (int k = 0; k < len; k++) {
+                    int l = s_in[start + k] - cfg->tol, h = s_in[start + k] + cfg->tol;
+                    lo[k] = (uint16_t)(l < 0 ? 0 : l);
+                    hi[k] = (uint16_t)(h > SCOPE_CODEC_MAX_CODE ? SCOPE_CODEC_MAX_CODE : h);
+                }
+                teach = false;
+            } else {
+                ref_wave(lo, hi, start, (uint16_t)len);
+            }
+            wave_end = -1;
+        }
+    }
+}
+
+static void check_cfg(const char* name, int max_frame) {
+    ref_run(&s_cfg);
+
+    scope_mask_init(&s_mask);
+    CHECK(scope_mask_config(&s_mask, &s_cfg));
+    for (int pos = 0; pos < N_SAMPLES;) {
+        int len = 1 + rand() % max_frame;
+        if (len > N_SAMPLES - pos) len = N_SAMPLES - pos;
+        scope_mask_feed(&s_mask, s_in + pos, len);
+        pos += len;
+    }
+
+    int bad = 0;
+    if (s_mask.tested != s_ref.tested || s_mask.passed != s_ref.passed || s_mask.failed != s_ref.failed ||
+        s_mask.num_captures != s_ref.num_captures) {
+        fprintf(stderr, "%s: tested/passed/failed/captures %u/%u/%u/%u, expected %u/%u/%u/%d\n", name,
+                (unsigned)s_mask.tested, (unsigned)s_mask.passed, (unsigned)s_mask.failed,
+                (unsigned)s_mask.num_captures, (unsigned)s_ref.tested, (unsigned)s_ref.passed,
+                (unsigned)s_ref.failed, s_ref.num_captures);
+        bad++;
+    }
+    for (int i = 0; i < s_ref.num_captures && i < s_mask.num_captures; i++) {
+        const scope_mask_capture_t* got = &s_mask.captures[i];
+        const scope_mask_capture_t* exp = &s_ref.captures[i];
+        if (got->t != exp->t || got->first_fail != exp->first_fail || got->violations != exp->violations ||
+            memcmp(got->samples, exp->samples, s_cfg.len * sizeof(uint16_t)) != 0) {
+            fprintf(stderr, "%s: capture %d t %u first_fail %u violations %u, expected t %u first_fail %u violations %u%s\n",
+                    name, i, (unsigned)got->t, got->first_fail, got->violations, (unsigned)exp->t,
+                    exp->first_fail, exp->violations,
+                    memcmp(got->samples, exp->samples, s_cfg.len * sizeof(uint16_t)) ? " (samples differ)" : "");
+            bad++;
+        }
+    }
+    // Want both outcomes, or the comparison above doesn't prove much
+    if (s_ref.passed == 0 || s_ref.failed == 0) {
+        fprintf(stderr, "%s: reference has %u passed, %u failed, pick a better mask\n", name,
+                (unsigned)s_ref.passed, (unsigned)s_ref.failed);
+        bad++;
+    }
+    printf("  %-24s %5u tested, %5u failed\n", name, (unsigned)s_ref.tested, (unsigned)s_ref.failed);
+    s_failures += bad;
+}
+
+static void flat_mask(uint16_t lo, uint16_t hi) {
+    for (int i = 0; i < SCOPE_MASK_MAX_LEN; i++) {
+        s_cfg.lo[i] = lo;
+        s_cfg.hi[i] = hi;
+    }
+}
+
+// Envelope around the sine as seen from a trigger at offset pre
+static void sine_mask(int period, int pre, int margin, bool falling) {
+    for (int i = 0; i < SCOPE_MASK_MAX_LEN; i++) {
+        double ph = 2 * M_PI * (i - pre) / period;
+        int v = 2048 + (int)lround(1000 * (falling ? -sin(ph) : sin(ph)));
+        s_cfg.lo[i] = (uint16_t)(v - margin);
+        s_cfg.hi[i] = (uint16_t)(v + margin);
+    }
+}
+
+static void set_cfg(scope_mask_mode_t mode, scope_mask_trig_t trig, uint16_t len, uint16_t pre) {
+    s_cfg.mode = mode;
+    s_cfg.trigger = trig;
+    s_cfg.level = 2048;
+    s_cfg.hyst = 100;
+    s_cfg.len = len;
+    s_cfg.pre = pre;
+    s_cfg.tol = 0;
+}
+
+int main(void) {
+    srand(1);
+    const int period = 250;
+    make_input(period);
+
+    // Free running: back-to-back windows, with a plain voltage limit
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_NONE, 1000, 0);
+    flat_mask(2048 - 1050, 2048 + 1050);
+    check_cfg("free running 1000", 1500);
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_NONE, 37, 0);
+    check_cfg("free running 37", 100);
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_NONE, SCOPE_MASK_MAX_LEN, 0);
+    check_cfg("free running max", 3000);
+
+    // Triggered, what the page sends: 1000 samples, 100 before the trigger.
+    // Frames both shorter than pre and longer than a whole waveform.
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_RISING, 1000, 100);
+    sine_mask(period, 100, 150, false);
+    check_cfg("rising 1000/100", 1500);
+    check_cfg("rising 1000/100 small", 40);
+
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_FALLING, 600, 250);
+    sine_mask(period, 250, 150, true);
+    check_cfg("falling 600/250", 700);
+
+    // Edge cases for the pre-trigger history
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_RISING, 300, 0);
+    sine_mask(period, 0, 150, false);
+    check_cfg("rising pre 0", 500);
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_RISING, 300, 299);
+    sine_mask(period, 299, 150, false);
+    check_cfg("rising pre len-1", 500);
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_RISING, SCOPE_MASK_MAX_LEN, SCOPE_MASK_MAX_LEN - 1);
+    sine_mask(period, SCOPE_MASK_MAX_LEN - 1, 150, false);
+    check_cfg("rising pre max", 2000);
+
+    // Teach: the first waveform becomes the mask. Tight enough that noise and
+    // trigger jitter fail some of the rest.
+    set_cfg(SCOPE_MASK_TEACH, SCOPE_MASK_TRIG_RISING, 500, 50);
+    s_cfg.tol = 60;
+    check_cfg("teach rising tol 60", 800);
+    CHECK(s_mask.mode == SCOPE_MASK_TEST);
+
+    // Bad configs are refused and leave the mask alone
+    set_cfg(SCOPE_MASK_TEST, SCOPE_MASK_TRIG_RISING, 1000, 100);
+    flat_mask(0, SCOPE_CODEC_MAX_CODE);
+    CHECK(scope_mask_config(&s_mask, &s_cfg));
+    uint32_t idx = s_mask.idx;
+    s_cfg.pre = 1000;
+    CHECK(!scope_mask_config(&s_mask, &s_cfg));
+    s_cfg.pre = 100;
+    s_cfg.len = SCOPE_MASK_MAX_LEN + 1;
+    CHECK(!scope_mask_config(&s_mask, &s_cfg));
+    s_cfg.len = 1000;
+    s_cfg.lo[10] = 3000;
+    s_cfg.hi[10] = 2000;
+    CHECK(!scope_mask_config(&s_mask, &s_cfg));
+    CHECK(s_mask.len == 1000 && s_mask.pre == 100 && s_mask.span[10] == SCOPE_CODEC_MAX_CODE && s_mask.idx == idx);
+
+    return test_result("test_mask");
+}
@@ -0,0 +1,172 @@
+// test_settings - host test for scope_settings + scope_boot against the
+// in-memory NVS in host/nvs_stub.c.
+//
+//   make -C tools test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+#include "scope_boot.h"
+#include "scope_settings.h"
+#include "test_util.h"
+
+static const scope_settings_t k_defaults = { 20000, 3, 100 };
+
+// Not memcmp, struct copies don't have to copy the padding
+static bool same(const scope_settings_t* a, const scope_settings_t* b) {
+    return a->sample_rate == b->sample_rate && a->atten == b->atten && a->test_hz == b->test_hz;
+}
+
+// Same layout as stored_settings_t in scope_settings.c
+static void put_raw(uint8_t version, uint8_t atten, uint16_t test_hz, uint32_t rate, size_t len) {
+    uint8_t blob[12] = { version, atten, test_hz & 0xff, test_hz >> 8,
+                         rate & 0xff, (rate >> 8) & 0xff, (rate >> 16) & 0xff, rate >> 24 };
+    nvs_handle_t h;
+    nvs_open("scope_cfg", NVS_READWRITE, &h);
+    nvs_set_blob(h, "scope", blob, len);
+    nvs_close(h);
+}
+
+static void fresh_nvs(void) {
+    nvs_stub_reset();
+    nvs_flash_init();
+}
+
+static void test_load_save(void) {
+    fresh_nvs();
+
+    scope_settings_t s = k_defaults;
+    CHECK(scope_settings_load(&s) != ESP_OK);
+    CHECK(same(&s, &k_defaults)); // untouched
+
+    scope_settings_t saved = { 50000, 1, 440 };
+    CHECK(scope_settings_save(&saved) == ESP_OK);
+    CHECK(nvs_stub_writes() == 1);
+
+    s = k_defaults;
+    CHECK(scope_settings_load(&s) == ESP_OK);
+    CHECK(s.sample_rate == 50000 && s.atten == 1 && s.test_hz == 440);
+}
+
+static void test_no_rewrite(void) {
+    fresh_nvs();
+
+    scope_settings_t s = { 40000, 2, 100 };
+    scope_settings_save(&s);
+    // The page re-sends the same config on every connect
+    for (int i = 0; i < 10; i++) scope_settings_save(&s);
+    CHECK(nvs_stub_writes() == 1);
+
+    s.test_hz = 200;
+    scope_settings_save(&s);
+    CHECK(nvs_stub_writes() == 2);
+}
+
+static void test_version_mismatch(void) {
+    fresh_nvs();
+    put_raw(99, 1, 440, 50000, 8);
+    scope_settings_t s = k_defaults;
+    CHECK(scope_settings_load(&s) == ESP_ERR_INVALID_VERSION);
+    CHECK(same(&s, &k_defaults));
+
+    // Right version but a blob from some other layout
+    fresh_nvs();
+    put_raw(1, 1, 440, 50000, 6);
+    CHECK(scope_settings_load(&s) != ESP_OK);
+    CHECK(same(&s, &k_defaults));
+}
+
+static void test_restore_clamps(void) {
+    // What used to boot-loop: a rate the ADC rejects, saved by an older /params
+    fresh_nvs();
+    put_raw(1, 7, 0, 2000000, 8);
+    scope_settings_t s = k_defaults;
+    CHECK(scope_settings_restore(&s));
+    CHECK(s.sample_rate == SCOPE_MAX_SAMPLE_RATE);
+    CHECK(s.atten == SCOPE_MAX_ATTEN);
+    CHECK(s.test_hz == k_defaults.test_hz); // 0 keeps the default
+
+    fresh_nvs();
+    put_raw(1, 0, 50, 100, 8);
+    s = k_defaults;
+    CHECK(scope_settings_restore(&s));
+    CHECK(s.sample_rate == SCOPE_MIN_SAMPLE_RATE && s.atten == 0 && s.test_hz == 50);
+
+    fresh_nvs();
+    s = k_defaults;
+    CHECK(!scope_settings_restore(&s));
+    CHECK(same(&s, &k_defaults));
+}
+
+static void test_erase(void) {
+    fresh_nvs();
+    scope_settings_t s = { 50000, 1, 440 };
+    scope_settings_save(&s);
+    scope_settings_erase();
+    s = k_defaults;
+    CHECK(scope_settings_load(&s) != ESP_OK);
+    CHECK(same(&s, &k_defaults));
+}
+
+// --- boot order ---
+
+static char s_trace[128];
+static scope_settings_t s_applied;
+
+static void step(const char* name) {
+    if (s_trace[0]) strncat(s_trace, ",", sizeof(s_trace) - strlen(s_trace) - 1);
+    strncat(s_trace, name, sizeof(s_trace) - strlen(s_trace) - 1);
+}
+
+static void fake_apply(const scope_settings_t* s) { s_applied = *s; step("apply"); }
+static void fake_signal(const scope_settings_t* s) { (void)s; step("signal"); }
+static void fake_adc(void) { step("adc"); }
+static bool fake_wifi(void) { step("wifi"); return true; }
+static void fake_udp(const scope_settings_t* s) { (void)s; step("udp"); }
+static void fake_web(void) { step("web"); }
+
+static const scope_boot_ops_t k_ops = {
+    .apply_settings = fake_apply,
+    .start_test_signal = fake_signal,
+    .start_adc = fake_adc,
+    .start_wifi = fake_wifi,
+    .start_udp = fake_udp,
+    .start_webserver = fake_web,
+};
+
+static void test_boot(void) {
+    nvs_stub_reset();
+    nvs_flash_init();
+    scope_settings_t stored = { 60000, 2, 300 };
+    scope_settings_save(&stored);
+
+    // Restored settings are applied before the ADC starts, and the ADC starts before WiFi
+    s_trace[0] = 0;
+    scope_settings_t s = k_defaults;
+    CHECK(scope_boot(&s, &k_ops) == true);
+    CHECK(strcmp(s_trace, "apply,signal,adc,wifi,udp,web") == 0);
+    CHECK(s_applied.sample_rate == 60000 && s_applied.atten == 2 && s_applied.test_hz == 300);
+
+    // Full NVS partition: erased and re-inited, boots on defaults
+    nvs_stub_reset();
+    nvs_stub_fail_next_init(ESP_ERR_NVS_NO_FREE_PAGES);
+    s_trace[0] = 0;
+    s = k_defaults;
+    scope_boot(&s, &k_ops);
+    CHECK(nvs_stub_erases() == 1);
+    CHECK(same(&s_applied, &k_defaults));
+    // ...and NVS works afterwards
+    CHECK(scope_settings_save(&stored) == ESP_OK);
+}
+
+int main(void) {
+    test_load_save();
+    test_no_rewrite();
+    test_version_mismatch();
+    test_restore_clamps();
+    test_erase();
+    test_boot();
+
+    return test_result("test_settings");
+}
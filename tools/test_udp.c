@@ -0,0 +1,317 @@
+// test_udp - host test for the UDP framing in scope_udp: header round trip,
+// splitting frames into datagrams, and the receiver's loss/late/duplicate/
+// restart accounting, including a simulated stream with device drops, network
+// loss, reordering and a reboot.
+//
+//   make -C tools test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scope_codec.h"
+#include "scope_udp.h"
+#include "test_util.h"
+
+static scope_udp_hdr_t hdr(uint32_t seq, uint32_t session, uint8_t flags, uint16_t tx_drops) {
+    return (scope_udp_hdr_t){
+        .flags = flags,
+        .seq = seq,
+        .first_sample = seq * 100,
+        .t_us = seq * 1000,
+        .sample_rate = 20000,
+        .count = 100,
+        .tx_drops = tx_drops,
+        .session = session,
+    };
+}
+
+static uint32_t feed(scope_udp_rx_t* rx, scope_udp_hdr_t h) {
+    return scope_udp_rx_account(rx, &h, SCOPE_UDP_HDR_LEN + scope_codec_len(h.count), (int64_t)h.t_us + 5000);
+}
+
+static void test_hdr(void) {
+    uint8_t buf[SCOPE_UDP_HDR_LEN + 8] = { 0 };
+    scope_udp_hdr_t in = {
+        .flags = SCOPE_UDP_FLAG_RECONFIG,
+        .seq = 0xfffffffe,
+        .first_sample = 0x12345678,
+        .t_us = 0x9abcdef0,
+        .sample_rate = 83333,
+        .count = 4,
+        .tx_drops = 0xfffe,
+        .session = 0xdeadbeef,
+    };
+    scope_udp_write_hdr(buf, &in);
+    CHECK(buf[0] == 'S' && buf[1] == 'C'); // "SC" on the wire
+
+    scope_udp_hdr_t out;
+    CHECK(scope_udp_read_hdr(buf, SCOPE_UDP_HDR_LEN + 8, &out));
+    CHECK(out.flags == in.flags && out.seq == in.seq && out.first_sample == in.first_sample &&
+          out.t_us == in.t_us && out.sample_rate == in.sample_rate && out.count == in.count &&
+          out.tx_drops == in.tx_drops && out.session == in.session);
+
+    // count has to match the length, and magic/version have to be ours
+    CHECK(!scope_udp_read_hdr(buf, SCOPE_UDP_HDR_LEN + 6, &out));
+    CHECK(!scope_udp_read_hdr(buf, SCOPE_UDP_HDR_LEN - 1, &out));
+    buf[2] = SCOPE_UDP_VERSION + 1;
+    CHECK(!scope_udp_read_hdr(buf, SCOPE_UDP_HDR_LEN + 8, &out));
+    buf[2] = SCOPE_UDP_VERSION;
+    buf[0] ^= 1;
+    CHECK(!scope_udp_read_hdr(buf, SCOPE_UDP_HDR_LEN + 8, &out));
+}
+
+// --- split / reassembly ---
+
+#define MAX_CAPTURED 64
+
+typedef struct {
+    uint8_t dgram[MAX_CAPTURED][SCOPE_UDP_MAX_DGRAM];
+    size_t len[MAX_CAPTURED];
+    int n;
+    int fail_mask; // bit i set: the i-th send() fails
+    int calls;
+} capture_t;
+
+static int capture_send(const uint8_t* dgram, size_t len, void* ctx) {
+    capture_t* c = ctx;
+    int call = c->calls++;
+    if (c->fail_mask & (1 << call)) return -1;
+    memcpy(c->dgram[c->n], dgram, len);
+    c->len[c->n++] = len;
+    return 0;
+}
+
+static void test_split(void) {
+    static capture_t cap;
+    static uint16_t samples[2048], back[2048];
+    for (int i = 0; i < 2048; i++) samples[i] = (uint16_t)((i * 37) & 0xfff);
+
+    scope_udp_tx_t tx;
+    scope_udp_tx_init(&tx, 83333, 0, 0x1234); // 0 = as many as fit
+    CHECK(tx.max_samples == SCOPE_UDP_MAX_SAMPLES);
+    scope_udp_tx_init(&tx, 83333, 500, 0x1234);
+
+    // 1668 samples (a full 20ms read at 83.3kHz) -> 500 + 500 + 500 + 168
+    memset(&cap, 0, sizeof(cap));
+    CHECK(scope_udp_tx_frame(&tx, samples, 1668, 777, capture_send, &cap) == 0);
+    CHECK(cap.n == 4);
+    uint32_t next = 0;
+    for (int i = 0; i < cap.n; i++) {
+        scope_udp_hdr_t h;
+        CHECK(scope_udp_read_hdr(cap.dgram[i], cap.len[i], &h));
+        CHECK(h.seq == (uint32_t)i && h.first_sample == next && h.t_us == 777 && h.session == 0x1234);
+        CHECK(h.count == (i < 3 ? 500 : 168));
+        CHECK(h.flags == (i == 0 ? SCOPE_UDP_FLAG_RECONFIG : 0)); // only on the first one
+        scope_codec_decode(back + h.first_sample, cap.dgram[i] + SCOPE_UDP_HDR_LEN, h.count);
+        next += h.count;
+    }
+    CHECK(memcmp(back, samples, 1668 * sizeof(uint16_t)) == 0);
+
+    // Drops on send: seq and first_sample still move on, the running total goes
+    // out in the next header, and RECONFIG waits for a datagram that made it
+    scope_udp_tx_reconfig(&tx, 50000);
+    memset(&cap, 0, sizeof(cap));
+    cap.fail_mask = 0x3; // the first two
+    CHECK(scope_udp_tx_frame(&tx, samples, 1500, 888, capture_send, &cap) == 2);
+    CHECK(cap.n == 1);
+    scope_udp_hdr_t h;
+    CHECK(scope_udp_read_hdr(cap.dgram[0], cap.len[0], &h));
+    CHECK(h.seq == 6 && h.first_sample == 1668 + 1000 && h.count == 500);
+    CHECK(h.tx_drops == 2 && h.flags == SCOPE_UDP_FLAG_RECONFIG && h.sample_rate == 50000);
+}
+
+// --- receiver accounting ---
+
+static void test_restart_detection(void) {
+    scope_udp_rx_t rx;
+    scope_udp_rx_init(&rx);
+    scope_udp_hdr_t h = hdr(5, 1, 0, 0);
+    CHECK(scope_udp_rx_is_restart(&rx, &h)); // nothing seen yet
+    feed(&rx, h);
+    for (uint32_t s = 6; s < 200; s++) feed(&rx, hdr(s, 1, 0, 0));
+
+    h = hdr(200, 1, 0, 0);
+    CHECK(!scope_udp_rx_is_restart(&rx, &h));
+    h = hdr(200, 2, 0, 0);
+    CHECK(scope_udp_rx_is_restart(&rx, &h)); // new session
+    h = hdr(200, 1, SCOPE_UDP_FLAG_RECONFIG, 0);
+    CHECK(scope_udp_rx_is_restart(&rx, &h));
+    h = hdr(200 - SCOPE_UDP_MAX_REORDER, 1, 0, 0);
+    CHECK(!scope_udp_rx_is_restart(&rx, &h)); // still reordering
+    h = hdr(200 - SCOPE_UDP_MAX_REORDER - 1, 1, 0, 0);
+    CHECK(scope_udp_rx_is_restart(&rx, &h)); // too far back
+    CHECK(rx.lost == 0 && rx.resyncs == 0);
+}
+
+static void test_gaps(void) {
+    scope_udp_rx_t rx;
+    scope_udp_rx_init(&rx);
+
+    CHECK(feed(&rx, hdr(0, 1, SCOPE_UDP_FLAG_RECONFIG, 0)) == 0);
+    CHECK(feed(&rx, hdr(1, 1, 0, 0)) == 0);
+    CHECK(feed(&rx, hdr(4, 1, 0, 0)) == 2); // 2 and 3 missing
+    CHECK(rx.lost == 2 && rx.received == 3);
+
+    CHECK(feed(&rx, hdr(3, 1, 0, 0)) == 0); // late: not lost after all
+    CHECK(rx.lost == 1 && rx.late == 1);
+    feed(&rx, hdr(3, 1, 0, 0));             // and again
+    feed(&rx, hdr(4, 1, 0, 0));
+    feed(&rx, hdr(0, 1, 0, 0));
+    CHECK(rx.duplicates == 3 && rx.lost == 1 && rx.received == 4);
+
+    // 63 back is the oldest one the window remembers
+    for (uint32_t s = 5; s < 70; s++) {
+        if (s != 6) feed(&rx, hdr(s, 1, 0, 0));
+    }
+    CHECK(rx.lost == 2);
+    feed(&rx, hdr(6, 1, 0, 0));
+    CHECK(rx.lost == 1 && rx.late == 2);
+    feed(&rx, hdr(6, 1, 0, 0));
+    CHECK(rx.duplicates == 4);
+}
+
+static void test_tx_drops(void) {
+    scope_udp_rx_t rx;
+    scope_udp_rx_init(&rx);
+
+    // Joined mid-session: the drops before we started listening aren't ours
+    feed(&rx, hdr(1000, 1, 0, 65530));
+    CHECK(rx.tx_drops == 0);
+    feed(&rx, hdr(1001, 1, 0, 65530));
+    // 11 drops, wrapping the u16 on the way, plus one lost in the air
+    CHECK(feed(&rx, hdr(1014, 1, 0, 5)) == 12);
+    CHECK(rx.lost == 12 && rx.tx_drops == 11);
+
+    // A late datagram carries an older total, it must not count again
+    feed(&rx, hdr(1013, 1, 0, 4));
+    CHECK(rx.tx_drops == 11 && rx.lost == 11 && rx.late == 1);
+    feed(&rx, hdr(1015, 1, 0, 5));
+    CHECK(rx.tx_drops == 11);
+}
+
+static void test_reboot(void) {
+    scope_udp_rx_t rx;
+    scope_udp_rx_init(&rx);
+    for (uint32_t s = 0; s < 10; s++) feed(&rx, hdr(s, 1, s ? 0 : SCOPE_UDP_FLAG_RECONFIG, 0));
+
+    // Reboot. seq 0 dropped on the device, 1 lost in the air, 2 is the first we see
+    scope_udp_hdr_t h = hdr(2, 2, SCOPE_UDP_FLAG_RECONFIG, 1);
+    CHECK(scope_udp_rx_is_restart(&rx, &h));
+    CHECK(feed(&rx, h) == 2);
+    CHECK(rx.resyncs == 1 && rx.lost == 2 && rx.tx_drops == 1 && rx.late == 0);
+
+    // A straggler from before the reboot is neither a restart nor loss
+    h = hdr(10, 1, 0, 0);
+    CHECK(scope_udp_rx_is_stale(&rx, &h));
+    CHECK(!scope_udp_rx_is_restart(&rx, &h));
+    feed(&rx, h);
+    CHECK(rx.stale == 1 && rx.resyncs == 1 && rx.lost == 2 && rx.session == 2);
+
+    CHECK(feed(&rx, hdr(3, 2, 0, 1)) == 0);
+    CHECK(rx.lost == 2 && rx.received == 12);
+
+    // Rate change on the same session: seq keeps going, so a gap still counts
+    CHECK(feed(&rx, hdr(6, 2, SCOPE_UDP_FLAG_RECONFIG, 2)) == 2);
+    CHECK(rx.resyncs == 2 && rx.lost == 4 && rx.tx_drops == 2);
+}
+
+// --- the whole thing ---
+
+typedef struct {
+    uint8_t dgram[SCOPE_UDP_MAX_DGRAM];
+    size_t len;
+} wire_t;
+
+#define WIRE_MAX 8192
+
+typedef struct {
+    wire_t* wire;
+    int n;
+    int device_drops;
+    int net_lost;
+} sim_t;
+
+static int sim_send(const uint8_t* dgram, size_t len, void* ctx) {
+    sim_t* s = ctx;
+    if (rand() % 100 < 3) {
+        s->device_drops++;
+        return -1;
+    }
+    if (rand() % 100 < 2) {
+        s->net_lost++;
+        return 0; // went out, never arrived
+    }
+    memcpy(s->wire[s->n].dgram, dgram, len);
+    s->wire[s->n].len = len;
+    s->n++;
+    return 0;
+}
+
+// Sends frames until at least n datagrams went out. The last one always goes
+// through cleanly: the device can't report drops after the last datagram we get.
+static void sim_session(sim_t* s, scope_udp_tx_t* tx, int frames) {
+    static uint16_t samples[1668];
+    for (int f = 0; f < frames; f++) {
+        scope_udp_tx_frame(tx, samples, 200 + rand() % 1468, f * 20000, sim_send, s);
+    }
+    capture_t* c = malloc(sizeof(capture_t));
+    memset(c, 0, sizeof(*c));
+    scope_udp_tx_frame(tx, samples, 100, frames * 20000, capture_send, c);
+    memcpy(s->wire[s->n].dgram, c->dgram[0], c->len[0]);
+    s->wire[s->n].len = c->len[0];
+    s->n++;
+    free(c);
+}
+
+static void test_stream(void) {
+    sim_t sim = { .wire = malloc(WIRE_MAX * sizeof(wire_t)) };
+    scope_udp_tx_t tx;
+
+    scope_udp_tx_init(&tx, 83333, SCOPE_UDP_MAX_SAMPLES, 0xaaaa);
+    sim_session(&sim, &tx, 1000);
+    int first_session = sim.n;
+    scope_udp_tx_init(&tx, 83333, SCOPE_UDP_MAX_SAMPLES, 0xbbbb); // reboot
+    sim_session(&sim, &tx, 1000);
+    CHECK(sim.n < WIRE_MAX);
+
+    // Light reordering: swap neighbours now and then, never across the reboot
+    int swaps = 0;
+    for (int i = 1; i + 2 < sim.n; i++) {
+        if (i + 1 != first_session && i != first_session && rand() % 50 == 0) {
+            wire_t tmp = sim.wire[i];
+            sim.wire[i] = sim.wire[i + 1];
+            sim.wire[i + 1] = tmp;
+            swaps++;
+            i++;
+        }
+    }
+
+    scope_udp_rx_t rx;
+    scope_udp_rx_init(&rx);
+    for (int i = 0; i < sim.n; i++) {
+        scope_udp_hdr_t h;
+        CHECK(scope_udp_read_hdr(sim.wire[i].dgram, sim.wire[i].len, &h));
+        scope_udp_rx_account(&rx, &h, sim.wire[i].len, (int64_t)h.t_us);
+    }
+
+    printf("  %d datagrams, %d dropped on device, %d lost in the air, %d swaps\n", sim.n, sim.device_drops,
+           sim.net_lost, swaps);
+    CHECK(rx.received == (uint64_t)sim.n);
+    CHECK(rx.tx_drops == (uint64_t)sim.device_drops);
+    CHECK(rx.lost == (uint64_t)(sim.device_drops + sim.net_lost));
+    CHECK(rx.resyncs == 1 && rx.duplicates == 0 && rx.stale == 0);
+    free(sim.wire);
+}
+
+int main(void) {
+    srand(1);
+    test_hdr();
+    test_split();
+    test_restart_detection();
+    test_gaps();
+    test_tx_drops();
+    test_reboot();
+    test_stream();
+    return test_result("test_udp");
+}
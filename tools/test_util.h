@@ -0,0 +1,29 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+// Bits shared by the host tests (test_*.c). Each test is one translation unit,
+// so the failure count can just be a static in here.
+
+#include <stdio.h>
+
+static int s_failures = 0;
+
+// Logs and counts the failure, keeps going so one run shows all of them
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        s_failures++; \
+    } \
+} while (0)
+
+// End of main(): return test_result("test_foo");
+static inline int test_result(const char* name) {
+    if (s_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, s_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,155 @@
+// test_wifi_cache - host test for scope_wifi_cache (the fast start AP/lease
+// cache) against the in-memory NVS in host/nvs_stub.c.
+//
+//   make -C tools test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+#include "scope_wifi_cache.h"
+#include "test_util.h"
+
+static const scope_wifi_cache_t k_cache = {
+    .version = SCOPE_WIFI_CACHE_VER,
+    .channel = 6,
+    .bssid = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 },
+    .has_ip = 1,
+    .ip = 0x2a01a8c0,      // 192.168.1.42
+    .netmask = 0x00ffffff, // 255.255.255.0
+    .gw = 0x0101a8c0,
+    .dns = 0x0101a8c0,
+};
+
+static void fresh_nvs(void) {
+    nvs_stub_reset();
+    nvs_flash_init();
+}
+
+static void put_raw(const void* blob, size_t len) {
+    nvs_handle_t h;
+    nvs_open("wifi_cfg", NVS_READWRITE, &h);
+    nvs_set_blob(h, "fast", blob, len);
+    nvs_close(h);
+}
+
+static bool has_key(const char* key) {
+    nvs_handle_t h;
+    if (nvs_open("wifi_cfg", NVS_READONLY, &h) != ESP_OK) return false;
+    size_t len = 0;
+    bool found = nvs_get_blob(h, key, NULL, &len) == ESP_OK;
+    nvs_close(h);
+    return found;
+}
+
+static void test_load_save(void) {
+    fresh_nvs();
+
+    scope_wifi_cache_t c;
+    CHECK(!scope_wifi_cache_load(&c)); // nothing stored yet
+
+    CHECK(scope_wifi_cache_save(&k_cache) == ESP_OK);
+    memset(&c, 0, sizeof(c));
+    CHECK(scope_wifi_cache_load(&c));
+    CHECK(memcmp(&c, &k_cache, sizeof(c)) == 0);
+}
+
+static void test_no_rewrite(void) {
+    fresh_nvs();
+
+    // Every reconnect to the same AP with the same lease
+    for (int i = 0; i < 10; i++) scope_wifi_cache_save(&k_cache);
+    CHECK(nvs_stub_writes() == 1);
+
+    scope_wifi_cache_t moved = k_cache;
+    moved.channel = 11;
+    scope_wifi_cache_save(&moved);
+    CHECK(nvs_stub_writes() == 2);
+    moved.dns = 0x08080808;
+    scope_wifi_cache_save(&moved);
+    CHECK(nvs_stub_writes() == 3);
+}
+
+static void test_validation(void) {
+    scope_wifi_cache_t c, bad;
+
+    // Older/newer layout
+    fresh_nvs();
+    bad = k_cache;
+    bad.version = SCOPE_WIFI_CACHE_VER + 1;
+    put_raw(&bad, sizeof(bad));
+    CHECK(!scope_wifi_cache_load(&c));
+
+    // Wrong size, e.g. a cache from before the lease was added
+    fresh_nvs();
+    put_raw(&k_cache, 8);
+    CHECK(!scope_wifi_cache_load(&c));
+
+    // Channels outside 1..14 can't be ours
+    static const uint8_t channels[] = { 0, 15, 255 };
+    for (size_t i = 0; i < sizeof(channels); i++) {
+        fresh_nvs();
+        bad = k_cache;
+        bad.channel = channels[i];
+        put_raw(&bad, sizeof(bad));
+        CHECK(!scope_wifi_cache_load(&c));
+    }
+    fresh_nvs();
+    bad = k_cache;
+    bad.channel = 14;
+    put_raw(&bad, sizeof(bad));
+    CHECK(scope_wifi_cache_load(&c) && c.channel == 14);
+
+    // An unusable lease: the AP is still worth going straight to, DHCP does the rest
+    fresh_nvs();
+    bad = k_cache;
+    bad.ip = 0;
+    put_raw(&bad, sizeof(bad));
+    CHECK(scope_wifi_cache_load(&c) && !c.has_ip && c.channel == 6);
+    fresh_nvs();
+    bad = k_cache;
+    bad.netmask = 0;
+    put_raw(&bad, sizeof(bad));
+    CHECK(scope_wifi_cache_load(&c) && !c.has_ip);
+}
+
+static void test_erase(void) {
+    fresh_nvs();
+
+    // Nothing there: still fine, it's what save_wifi does on a fresh device
+    CHECK(scope_wifi_cache_erase() == ESP_OK);
+
+    // Credentials live in the same namespace and must survive
+    nvs_handle_t h;
+    nvs_open("wifi_cfg", NVS_READWRITE, &h);
+    nvs_set_blob(h, "ssid", "home", 5);
+    nvs_close(h);
+
+    scope_wifi_cache_save(&k_cache);
+    CHECK(scope_wifi_cache_erase() == ESP_OK);
+    scope_wifi_cache_t c;
+    CHECK(!scope_wifi_cache_load(&c));
+    CHECK(!has_key("fast") && has_key("ssid"));
+
+    // And a save after the erase writes again instead of matching a stale copy
+    int writes = nvs_stub_writes();
+    scope_wifi_cache_save(&k_cache);
+    CHECK(nvs_stub_writes() == writes + 1 && scope_wifi_cache_load(&c));
+}
+
+static void test_no_nvs(void) {
+    nvs_stub_reset(); // not initialized
+    scope_wifi_cache_t c;
+    CHECK(!scope_wifi_cache_load(&c));
+    CHECK(scope_wifi_cache_save(&k_cache) != ESP_OK);
+    CHECK(scope_wifi_cache_erase() != ESP_OK);
+}
+
+int main(void) {
+    test_load_save();
+    test_no_rewrite();
+    test_validation();
+    test_erase();
+    test_no_nvs();
+    return test_result("test_wifi_cache");
+}
@@ -0,0 +1,114 @@
+// test_ws - host test for the WebSocket bits in scope_ws: the handshake key,
+// frame headers at every length-encoding boundary, and unmasking.
+//
+//   make -C tools test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "scope_ws.h"
+#include "test_util.h"
+
+static void test_accept_key(void) {
+    char out[29];
+    // RFC 6455 section 1.3
+    ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==", out);
+    CHECK(strcmp(out, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+    ws_accept_key("x3JJHMbDL1EzLkh9GBhXDw==", out);
+    CHECK(strcmp(out, "HSmrc0sMlYUkAGmm5OPpG2HaGWk=") == 0);
+
+    // 16 random bytes -> 22 base64 chars + "=="
+    char key[25];
+    ws_make_key(key);
+    CHECK(strlen(key) == 24 && key[22] == '=' && key[23] == '=');
+    for (int i = 0; i < 22; i++) {
+        char c = key[i];
+        CHECK((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/');
+    }
+}
+
+static void check_hdr(uint8_t opcode, uint64_t len, const uint8_t* mask, int expect_len) {
+    uint8_t buf[WS_MAX_HDR];
+    int n = ws_write_hdr(buf, opcode, len, mask);
+    if (n != expect_len) {
+        fprintf(stderr, "len %llu%s: header %d bytes, expected %d\n", (unsigned long long)len,
+                mask ? " masked" : "", n, expect_len);
+        s_failures++;
+        return;
+    }
+
+    ws_frame_hdr_t h;
+    CHECK(ws_parse_hdr(buf, (size_t)n, &h) == n);
+    CHECK(h.fin && h.opcode == opcode && h.len == len && h.masked == (mask != NULL));
+    if (mask) CHECK(memcmp(h.mask, mask, 4) == 0);
+
+    // Short reads: never a header, never garbage
+    for (int i = 0; i < n; i++) CHECK(ws_parse_hdr(buf, (size_t)i, &h) == 0);
+}
+
+static void test_hdr(void) {
+    static const uint8_t mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+    static const struct {
+        uint64_t len;
+        int hdr;
+    } cases[] = {
+        { 0, 2 }, { 1, 2 }, { 125, 2 },                  // 7-bit length
+        { 126, 4 }, { 4096, 4 }, { 65535, 4 },           // 16-bit
+        { 65536, 10 }, { 1ull << 32, 10 }, { (1ull << 63) - 1, 10 }, // 64-bit
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        check_hdr(WS_OP_BINARY, cases[i].len, NULL, cases[i].hdr);
+        check_hdr(WS_OP_TEXT, cases[i].len, mask, cases[i].hdr + 4);
+    }
+
+    // The exact bytes at the boundaries
+    uint8_t buf[WS_MAX_HDR];
+    ws_write_hdr(buf, WS_OP_BINARY, 125, NULL);
+    CHECK(buf[0] == 0x82 && buf[1] == 125);
+    ws_write_hdr(buf, WS_OP_BINARY, 126, NULL);
+    CHECK(buf[1] == 126 && buf[2] == 0x00 && buf[3] == 126);
+    ws_write_hdr(buf, WS_OP_BINARY, 65535, mask);
+    CHECK(buf[1] == (0x80 | 126) && buf[2] == 0xff && buf[3] == 0xff && memcmp(buf + 4, mask, 4) == 0);
+    ws_write_hdr(buf, WS_OP_BINARY, 65536, NULL);
+    static const uint8_t len64[] = { 127, 0, 0, 0, 0, 0, 1, 0, 0 };
+    CHECK(memcmp(buf + 1, len64, sizeof(len64)) == 0);
+
+    // Control frames and continuation don't get FIN mixed into the opcode
+    ws_frame_hdr_t h;
+    static const uint8_t ping[] = { 0x89, 0x00 }, cont[] = { 0x00, 0x05 };
+    CHECK(ws_parse_hdr(ping, sizeof(ping), &h) == 2 && h.fin && h.opcode == WS_OP_PING && h.len == 0);
+    CHECK(ws_parse_hdr(cont, sizeof(cont), &h) == 2 && !h.fin && h.opcode == WS_OP_CONT && h.len == 5);
+
+    // RSV bits without a negotiated extension
+    static const uint8_t rsv[] = { 0xc2, 0x05 };
+    CHECK(ws_parse_hdr(rsv, sizeof(rsv), &h) == -1);
+}
+
+static void test_unmask(void) {
+    // RFC 6455 section 5.7: a masked "Hello" from a client
+    uint8_t frame[] = { 0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58 };
+    ws_frame_hdr_t h;
+    int n = ws_parse_hdr(frame, sizeof(frame), &h);
+    CHECK(n == 6 && h.masked && h.len == 5);
+    ws_unmask(frame + n, 5, h.mask, 0);
+    CHECK(memcmp(frame + n, "Hello", 5) == 0);
+
+    // Unmasking in pieces, as reads come in, is the same as all at once
+    uint8_t whole[1000], split[1000];
+    for (int i = 0; i < 1000; i++) whole[i] = split[i] = (uint8_t)(i * 7);
+    ws_unmask(whole, sizeof(whole), h.mask, 0);
+    size_t pos = 0;
+    static const size_t pieces[] = { 1, 2, 3, 5, 100, 333, 556 };
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        ws_unmask(split + pos, pieces[i], h.mask, pos);
+        pos += pieces[i];
+    }
+    CHECK(pos == sizeof(split) && memcmp(whole, split, sizeof(whole)) == 0);
+}
+
+int main(void) {
+    test_accept_key();
+    test_hdr();
+    test_unmask();
+    return test_result("test_ws");
+}